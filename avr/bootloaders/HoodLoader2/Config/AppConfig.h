@@ -67,4 +67,100 @@ along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
 	#define NO_FLASH_BYTE_SUPPORT
 //	#define NO_LOCK_BYTE_WRITE_SUPPORT
 
+	/* Faster code paths of the USB-Serial bridge and the bootloader. The default build keeps the smaller original
+	 * code, since the 4KB bootloader section has no room left for all of them at once. The 0.4 release uses 3880 of
+	 * the 4000 bytes in front of the bootloader API table, and the sizes of the options are not measured yet. Check
+	 * every combination with "make size" for each MCU. A build which is too large fails to link, since its .text
+	 * section overlaps the API table.
+	 */
+//	#define USART_TX_BUFFER_SUPPORT      // interrupt driven USB->USART buffer that takes whole packets at once
+//	#define BLOCK_COPY_SUPPORT           // copy the USART->USB buffer into the IN endpoint in contiguous runs
+//	#define EXACT_BAUDRATE_SUPPORT       // pick the USART speed mode with the lowest baud rate error
+//	#define PIPELINED_WRITE_SUPPORT      // program a flash page while the next block is received, skip unchanged pages
+//	#define BURST_READ_SUPPORT           // fill whole IN packets straight from the flash on block reads
+//	#define BLANK_PAGE_SKIP_SUPPORT      // only erase pages which are not blank on a chip erase
+
+	/* Optional class requests of the USB-Serial bridge, see HoodLoader2_Requests. GetBaudRate also needs
+	 * EXACT_BAUDRATE_SUPPORT.
+	 */
+//	#define DROPPED_BYTES_SUPPORT        // count USART bytes lost to a full buffer, GetDroppedBytes
+//	#define LATENCY_TIMER_SUPPORT        // coalesce small IN packets for some ms, Set/GetLatencyTimer
+
+	/* Optional HoodLoader2 extensions of the AVR109 protocol. The 4KB bootloader section is almost full with the
+	 * default features, so other features may need to be disabled above to make them fit. The streaming and the
+	 * compressed write need PIPELINED_WRITE_SUPPORT.
+	 */
+//	#define PAGE_CRC_SUPPORT
+//	#define ERASE_RANGE_SUPPORT
+//	#define STREAM_WRITE_SUPPORT
+//	#define COMPRESSED_WRITE_SUPPORT
+
+	/* Read the double tap window after an external reset from the last EEPROM byte (in 10ms steps) instead of always
+	 * waiting 750ms. 0 starts the sketch at once, 0xFF (erased) keeps the default. The sketch must not use this byte.
+	 */
+//	#define EXT_RESET_TIMEOUT_EEPROM
+
+	/* Turn the DTR auto reset into a fixed reset pulse of this many ms (Timer0 ticks) instead of holding the main MCU
+	 * in reset for as long as DTR is set. DSR is cleared at the start of the pulse and set again once the reset line
+	 * is released, both changes are reported to the host with a CDC SERIAL_STATE notification.
+	 */
+//	#define AUTO_RESET_PULSE_MS          2
+
+	/* Measure the baud rate of the main MCU when the host selects AUTOBAUD_BAUDRATE. The shortest of the first
+	 * AUTOBAUD_EDGES pulses on RX (PD2/INT2) is timed with Timer1 and taken as one bit, so the main MCU should send
+	 * a few 0x55 bytes. Those bytes are lost. GetLineEncoding returns the detected baud rate afterwards.
+	 */
+//	#define AUTOBAUD_SUPPORT
+	#define AUTOBAUD_BAUDRATE            1
+	#define AUTOBAUD_EDGES               16
+
+	/* Count framing, parity and overrun errors of the USART and report them together with bytes lost to a full
+	 * buffer as CDC SERIAL_STATE notifications, at most one every SERIAL_ERROR_INTERVAL_MS.
+	 */
+//	#define SERIAL_ERROR_SUPPORT
+	#define SERIAL_ERROR_INTERVAL_MS     32
+
+	/* Timestamped framing mode, turned on with the HOODLOADER2_REQ_SetTimestamps class request. Bytes from the main
+	 * MCU are grouped into bursts, separated by a gap of two characters, and sent to the host as chunks with the
+	 * Timer1 arrival time (CPU cycles) of their first byte. TIMESTAMP_RECORDS bursts can be buffered at once.
+	 */
+//	#define TIMESTAMP_SUPPORT
+	#define TIMESTAMP_RECORDS            8
+
+	/* COBS packet framing, turned on with the HOODLOADER2_REQ_SetFraming class request. Only whole frames (ending with
+	 * a 0x00 delimiter) are sent to the host, so every USB transfer ends at a frame boundary. Optionally a CRC-16
+	 * (XMODEM, MSB first after the payload) is checked on the 16u2 and corrupt frames are dropped.
+	 */
+//	#define FRAMING_SUPPORT
+
+	/* SPI side channel from the main MCU to the host. The 16u2 is an SPI slave on its ICSP pins (SS, SCK, MOSI, MISO
+	 * on PB0-PB3, see the HoodLoader2 variant), which have to be wired to the SPI pins of the main MCU. The data is
+	 * sent to the host on a vendor specific bulk IN interface next to the CDC bridge. The main MCU has to leave about
+	 * 4us between the bytes (SPI clock F_CPU/8) for the ISR. The CDC IN endpoint loses its second bank for it.
+	 */
+//	#define SPI_CHANNEL_SUPPORT
+
+	/* Vendor specific bootloader control interface next to the CDC bridge. The host can read the fuses, the version
+	 * and the flash contents and checksums with vendor requests on the control endpoint while the bridge is in use,
+	 * without switching to the bootloader baud rate. The flash requests are stalled while the bootloader baud rate
+	 * is set, since they would disturb its page writes. The interface has no endpoints of its own.
+	 */
+//	#define BOOT_CONTROL_INTERFACE
+
+	/* Optional hardware flow control for the USB-Serial bridge on the 16u2 header pins. Both lines are active low.
+	 * RTS is driven by the 16u2 and asks the main MCU to stop sending while the USART->USB buffer is filled up.
+	 * CTS is driven by the main MCU and pauses the transmission of USB data to it while it is high. This needs
+	 * USART_TX_BUFFER_SUPPORT.
+	 */
+//	#define HARDWARE_FLOW_CONTROL
+	#define FLOW_CONTROL_PORT            PORTB
+	#define FLOW_CONTROL_DDR             DDRB
+	#define FLOW_CONTROL_PIN             PINB
+	#define FLOW_CONTROL_RTS_MASK        (1 << PB4)
+	#define FLOW_CONTROL_CTS_MASK        (1 << PB5)
+
+	// RTS is set above the high watermark and cleared again below the low watermark of the USART->USB buffer
+	#define FLOW_CONTROL_HIGH_WATERMARK  (BUFFER_SIZE - (BUFFER_SIZE / 4))
+	#define FLOW_CONTROL_LOW_WATERMARK   (BUFFER_SIZE / 4)
+
 #endif
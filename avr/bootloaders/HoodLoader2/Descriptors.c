@@ -74,16 +74,29 @@ const USB_Descriptor_Device_t DeviceDescriptor =
 {
 	.Header                 = {.Size = sizeof(USB_Descriptor_Device_t), .Type = DTYPE_Device},
 
+#if defined(COMPOSITE_DEVICE)
+	// interface association descriptors need USB 2.0
+	.USBSpecification       = VERSION_BCD(2,0,0),
+	.Class                  = USB_CSCP_IADDeviceClass,
+	.SubClass               = USB_CSCP_IADDeviceSubclass,
+	.Protocol               = USB_CSCP_IADDeviceProtocol,
+#else
 	.USBSpecification       = VERSION_BCD(1,1,0),
 	.Class                  = CDC_CSCP_CDCClass,
 	.SubClass               = CDC_CSCP_NoSpecificSubclass,
 	.Protocol               = CDC_CSCP_NoSpecificProtocol,
+#endif
 
 	.Endpoint0Size          = FIXED_CONTROL_ENDPOINT_SIZE,
 
 	// passed through makefile
 	.VendorID = VENDORID,
+#if defined(COMPOSITE_DEVICE)
+	// the CDC function is interface MI_00 of a composite device, which needs its own driver entry, see HoodLoader2.inf
+	.ProductID = COMPOSITE_PRODUCTID,
+#else
 	.ProductID = PRODUCTID,
+#endif
 	.ReleaseNumber          = VERSION_BCD(2,0,4),
 
 	.ManufacturerStrIndex   = STRING_ID_Manufacturer,
@@ -105,7 +118,7 @@ const USB_Descriptor_Configuration_t ConfigurationDescriptor =
 			.Header                 = {.Size = sizeof(USB_Descriptor_Configuration_Header_t), .Type = DTYPE_Configuration},
 
 			.TotalConfigurationSize = sizeof(USB_Descriptor_Configuration_t),
-			.TotalInterfaces        = 2,
+			.TotalInterfaces        = INTERFACE_ID_TOTAL,
 
 			.ConfigurationNumber    = 1,
 			.ConfigurationStrIndex  = NO_DESCRIPTOR,
@@ -115,6 +128,22 @@ const USB_Descriptor_Configuration_t ConfigurationDescriptor =
 			.MaxPowerConsumption    = USB_CONFIG_POWER_MA(100)
 		},
 
+#if defined(COMPOSITE_DEVICE)
+	.CDC_IAD =
+		{
+			.Header                 = {.Size = sizeof(USB_Descriptor_Interface_Association_t), .Type = DTYPE_InterfaceAssociation},
+
+			.FirstInterfaceIndex    = INTERFACE_ID_CDC_CCI,
+			.TotalInterfaces        = 2,
+
+			.Class                  = CDC_CSCP_CDCClass,
+			.SubClass               = CDC_CSCP_ACMSubclass,
+			.Protocol               = CDC_CSCP_ATCommandProtocol,
+
+			.IADStrIndex            = NO_DESCRIPTOR
+		},
+#endif
+
 	.CDC_CCI_Interface =
 		{
 			.Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},
@@ -163,7 +192,11 @@ const USB_Descriptor_Configuration_t ConfigurationDescriptor =
 			.EndpointAddress        = CDC_NOTIFICATION_EPADDR,
 			.Attributes             = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
 			.EndpointSize           = CDC_NOTIFICATION_EPSIZE,
+#if defined(SERIAL_STATE_SUPPORT)
+			.PollingIntervalMS      = 0x01
+#else
 			.PollingIntervalMS      = 0xFF
+#endif
 		},
 
 	.CDC_DCI_Interface =
@@ -200,7 +233,53 @@ const USB_Descriptor_Configuration_t ConfigurationDescriptor =
 			.Attributes             = (EP_TYPE_BULK | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
 			.EndpointSize           = CDC_TX_EPSIZE,
 			.PollingIntervalMS      = 0x05
-		}
+		},
+
+#if defined(SPI_CHANNEL_SUPPORT)
+	.SPI_Interface =
+		{
+			.Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},
+
+			.InterfaceNumber        = INTERFACE_ID_SPI,
+			.AlternateSetting       = 0,
+
+			.TotalEndpoints         = 1,
+
+			.Class                  = USB_CSCP_VendorSpecificClass,
+			.SubClass               = USB_CSCP_VendorSpecificSubclass,
+			.Protocol               = USB_CSCP_VendorSpecificProtocol,
+
+			.InterfaceStrIndex      = NO_DESCRIPTOR
+		},
+
+	.SPI_DataInEndpoint =
+		{
+			.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
+
+			.EndpointAddress        = SPI_CHANNEL_EPADDR,
+			.Attributes             = (EP_TYPE_BULK | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
+			.EndpointSize           = SPI_CHANNEL_EPSIZE,
+			.PollingIntervalMS      = 0x05
+		},
+#endif
+
+#if defined(BOOT_CONTROL_INTERFACE)
+	.BootControl_Interface =
+		{
+			.Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},
+
+			.InterfaceNumber        = INTERFACE_ID_BOOTCTRL,
+			.AlternateSetting       = 0,
+
+			.TotalEndpoints         = 0,
+
+			.Class                  = USB_CSCP_VendorSpecificClass,
+			.SubClass               = USB_CSCP_VendorSpecificSubclass,
+			.Protocol               = USB_CSCP_VendorSpecificProtocol,
+
+			.InterfaceStrIndex      = NO_DESCRIPTOR
+		},
+#endif
 };
 
 /** Language descriptor structure. This descriptor, located in SRAM memory, is returned when the host requests
@@ -110,6 +110,9 @@ along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
 			#error The selected AVR part is not currently supported by this bootloader.
 		#endif
 
+		/** Endpoint address of the SPI side channel bulk IN endpoint. */
+		#define SPI_CHANNEL_EPADDR             (ENDPOINT_DIR_IN | 1)
+
 		/** Endpoint address for the CDC control interface event notification endpoint. */
 		#define CDC_NOTIFICATION_EPADDR        (ENDPOINT_DIR_IN | 2)
 
@@ -119,15 +122,46 @@ along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
 		/** Endpoint address for the CDC data interface RX (data OUT) endpoint. */
 		#define CDC_RX_EPADDR                  (ENDPOINT_DIR_OUT | 4)
 
-		/** Size of the CDC data interface TX and RX data endpoint banks, in bytes. */
+		/** Size of the CDC data interface TX and RX data endpoint banks, in bytes. The U2 series only has 176 bytes
+		 *  of endpoint DPRAM (8 control + 8 notification), so the TX endpoint is double banked at full size to
+		 *  sustain back to back packets and the RX endpoint uses a single smaller bank to fit the remaining space.
+		 */
 		#define CDC_TX_EPSIZE                64
-#define CDC_TX_BANK_SIZE 1
-		#define CDC_RX_EPSIZE                64
-#define CDC_RX_BANK_SIZE 1
+		#if defined(SPI_CHANNEL_SUPPORT)
+		#define CDC_TX_BANK_SIZE             1
+		#else
+		#define CDC_TX_BANK_SIZE             2
+		#endif
+		#define CDC_RX_EPSIZE                32
+		#define CDC_RX_BANK_SIZE             1
+
+		/** Size of the SPI side channel endpoint banks, in bytes. It takes the second bank of the CDC TX endpoint,
+		 *  so the SPI ISR can fill one bank while the host reads the other one.
+		 */
+		#define SPI_CHANNEL_EPSIZE           32
+		#define SPI_CHANNEL_BANK_SIZE        2
 
 		/** Size of the CDC control interface notification endpoint bank, in bytes. */
 		#define CDC_NOTIFICATION_EPSIZE        8
 
+		/** Features that report the serial state to the host on the notification endpoint. The endpoint is then
+		 *  polled every ms instead of every 255ms.
+		 */
+		#if defined(AUTO_RESET_PULSE_MS) || defined(SERIAL_ERROR_SUPPORT)
+			#define SERIAL_STATE_SUPPORT
+		#endif
+
+		/** Features that add more interfaces next to the CDC bridge. The CDC interfaces are then grouped with an
+		 *  interface association descriptor.
+		 */
+		#if defined(SPI_CHANNEL_SUPPORT) || defined(BOOT_CONTROL_INTERFACE)
+			#define COMPOSITE_DEVICE
+		#endif
+
+		#if defined(COMPOSITE_DEVICE) && !defined(COMPOSITE_PRODUCTID)
+			#error A composite device needs its own COMPOSITE_PRODUCTID, see the makefile.
+		#endif
+
 	/* Type Defines: */
 		/** Type define for the device configuration descriptor structure. This must be defined in the
 		 *  application code, as the configuration descriptor contains several sub-descriptors which
@@ -137,6 +171,10 @@ along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
 		{
 			USB_Descriptor_Configuration_Header_t    Config;
 
+			#if defined(COMPOSITE_DEVICE)
+			USB_Descriptor_Interface_Association_t   CDC_IAD;
+			#endif
+
 			// CDC Control Interface
 			USB_Descriptor_Interface_t               CDC_CCI_Interface;
 			USB_CDC_Descriptor_FunctionalHeader_t    CDC_Functional_Header;
@@ -148,6 +186,17 @@ along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
 			USB_Descriptor_Interface_t               CDC_DCI_Interface;
 			USB_Descriptor_Endpoint_t                CDC_DataOutEndpoint;
 			USB_Descriptor_Endpoint_t                CDC_DataInEndpoint;
+
+			#if defined(SPI_CHANNEL_SUPPORT)
+			// SPI side channel Interface
+			USB_Descriptor_Interface_t               SPI_Interface;
+			USB_Descriptor_Endpoint_t                SPI_DataInEndpoint;
+			#endif
+
+			#if defined(BOOT_CONTROL_INTERFACE)
+			// Bootloader control Interface
+			USB_Descriptor_Interface_t               BootControl_Interface;
+			#endif
 		} USB_Descriptor_Configuration_t;
 
 		/** Enum for the device interface descriptor IDs within the device. Each interface descriptor
@@ -158,6 +207,13 @@ along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
 		{
 			INTERFACE_ID_CDC_CCI = 0, /**< CDC CCI interface descriptor ID */
 			INTERFACE_ID_CDC_DCI = 1, /**< CDC DCI interface descriptor ID */
+			#if defined(SPI_CHANNEL_SUPPORT)
+			INTERFACE_ID_SPI     = 2, /**< SPI side channel interface descriptor ID */
+			#endif
+			#if defined(BOOT_CONTROL_INTERFACE)
+			INTERFACE_ID_BOOTCTRL,    /**< Bootloader control interface descriptor ID */
+			#endif
+			INTERFACE_ID_TOTAL,       /**< Number of interfaces */
 		};
 
 		/** Enum for the device string descriptor IDs within the device. Each string descriptor should
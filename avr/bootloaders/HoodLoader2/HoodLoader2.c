@@ -65,26 +65,162 @@ static CDC_LineEncoding_t LineEncoding = { .BaudRateBPS = 0,
 .DataBits = 8 };
 
 /** Underlying data buffer for \ref USARTtoUSB_Buffer, where the stored bytes are located. */
+// the size can be passed through the makefile to match the SRAM of the target
+#if !defined(BUFFER_SIZE)
 #define BUFFER_SIZE 128 // 2^x is for better performence (32,64,128,256)
+#endif
+
+// use 16 bit counters only if the buffer does not fit into 8 bit, this keeps the ISR small
+#if (BUFFER_SIZE > 255)
+typedef uint16_t BufferCount_t;
+#else
+typedef uint8_t BufferCount_t;
+#endif
+
+#if defined(BUFFER_BEHIND_BOOTKEY)
+// A large buffer does not fit below the magic boot key at 0x0280 and would overwrite it. The makefile links the
+// .noinit section to 0x0280 instead, its first byte is the boot key and the buffer follows it. The linker refuses
+// to build if .data or .bss grow into it, and the boot key is not cleared at startup either.
+static uint8_t      USARTtoUSB_Buffer_Space[1 + BUFFER_SIZE] __attribute__((section(".noinit")));
+#define USARTtoUSB_Buffer_Data (&USARTtoUSB_Buffer_Space[1])
+#else
 static uint8_t      USARTtoUSB_Buffer_Data[BUFFER_SIZE];
-static volatile uint8_t BufferCount = 0; // Number of bytes currently stored in the buffer
-static uint8_t BufferIndex = 0; // position of the first buffer byte (Buffer out)
-static uint8_t BufferEnd = 0; // position of the last buffer byte (Serial in)
+#endif
+static volatile BufferCount_t BufferCount = 0; // Number of bytes currently stored in the buffer
+static BufferCount_t BufferIndex = 0; // position of the first buffer byte (Buffer out)
+static BufferCount_t BufferEnd = 0; // position of the last buffer byte (Serial in)
+
+#if defined(DROPPED_BYTES_SUPPORT)
+// Number of received bytes that were lost because the buffer was full, saturates at 0xFFFF
+static volatile uint16_t DroppedBytes = 0;
+#endif
+
+#if defined(USART_TX_BUFFER_SUPPORT) || defined(PIPELINED_WRITE_SUPPORT)
+/** Underlying data buffer for the USB to USART direction, drained by the USART data register empty ISR. */
+#define USBTOUSART_BUFFER_SIZE 128 // holds several packets so a new one can be taken while the last one is sent
+static uint8_t      USBtoUSART_Buffer_Data[USBTOUSART_BUFFER_SIZE];
+#endif
+#if defined(USART_TX_BUFFER_SUPPORT)
+static volatile uint8_t USBtoUSART_BufferCount = 0; // Number of bytes currently stored in the buffer
+static uint8_t USBtoUSART_BufferIndex = 0; // position of the first buffer byte (Serial out)
+static uint8_t USBtoUSART_BufferEnd = 0; // position of the last buffer byte (USB in)
+#endif
+
+#if defined(HOODLOADER2_PROFILING)
+/** Cycle and invocation counters of the hot paths, read by the host with \ref HOODLOADER2_REQ_GetProfile. */
+static Profile_Counter_t ProfileCounters[PROFILE_SLOT_COUNT];
+#endif
 
 // Led Pulse count
-#define TX_RX_LED_PULSE_MS 3
+#define TX_RX_LED_PULSE_MS 12
 static uint8_t TxLEDPulse = 0;
 static uint8_t RxLEDPulse = 0;
 
+#if defined(LATENCY_TIMER_SUPPORT)
+// Latency timer like the FTDI chips have. A partial IN packet is only sent once the last packet is older than
+// this many ms, full packets are always sent immediately. The host can change it with a class request.
+#define DEFAULT_LATENCY_TIMER_MS 1
+static uint8_t LatencyTimerMS = DEFAULT_LATENCY_TIMER_MS;
+static uint8_t LatencyTicks = 0xFF; // ms since the last IN packet, saturates
+#endif
+
+#if defined(AUTO_RESET_PULSE_MS)
+// remaining ms of the reset pulse on the main MCU and the DTR state of the last SetControlLineState request
+static uint8_t ResetPulseTicks = 0;
+static bool LastDTR = false;
+#endif
+
+#if defined(SERIAL_STATE_SUPPORT)
+/** Serial state bits (CDC_CONTROL_LINE_IN_*) for the host. The 10 byte notification is bigger than the notification
+ *  endpoint, so it is sent in two packets without waiting for the host: 0 = idle, 1 = header next, 2 = state next.
+ */
+static uint16_t SerialState = CDC_CONTROL_LINE_IN_DSR | CDC_CONTROL_LINE_IN_DCD;
+static uint8_t SerialStateNotification = 0;
+#endif
+
+#if defined(EXACT_BAUDRATE_SUPPORT)
+// baud rate divider of the USART in units of 8 CPU cycles per bit
+static uint16_t BaudDivider = 1;
+#endif
+
+#if defined(AUTOBAUD_SUPPORT)
+// number of edges seen on the RX line and the shortest pulse between them in CPU cycles while measuring the baud rate
+static volatile uint8_t AutobaudEdges = 0;
+static uint16_t AutobaudLastEdge;
+static volatile uint16_t AutobaudMinPulse;
+#endif
+
+#if defined(SERIAL_ERROR_SUPPORT)
+// USART error counters and the error bits (CDC_CONTROL_LINE_IN_*) not reported to the host yet
+static volatile HoodLoader2_SerialErrors_t SerialErrors;
+static volatile uint8_t SerialErrorBits = 0;
+static uint8_t SerialErrorTicks = 0;
+#endif
+
+#if defined(TIMESTAMP_SUPPORT)
+/** Bursts in the USART->USB buffer for the timestamped framing mode, oldest first. Only the newest burst grows,
+ *  unless CDC_Task() closed it to send it.
+ */
+static bool TimestampMode = false;
+static Timestamp_Record_t TimestampRecords[TIMESTAMP_RECORDS];
+static uint8_t TimestampHead = 0;
+static volatile uint8_t TimestampCount = 0;
+static volatile bool TimestampClosed = false;
+static uint32_t TimestampLastByte;
+static uint32_t TimestampGap;
+
+// upper 16 bit of the Timer1 timestamps
+static volatile uint16_t TimestampHigh = 0;
+#endif
+
+#if defined(FRAMING_SUPPORT)
+/** COBS framing state. The USART->USB buffer holds FramedBytes of complete frames, followed by FrameLength bytes
+ *  of the frame that is still received. Only the complete frames are sent to the host.
+ */
+static uint8_t FramingMode = FRAMING_MODE_NONE;
+static volatile BufferCount_t FramedBytes = 0;
+static BufferCount_t FrameLength = 0;
+static bool FrameDiscard = false; // the rest of a too long frame is dropped until the next delimiter
+static volatile uint16_t DroppedFrames = 0;
+
+// streaming COBS decoder for the CRC of the current frame
+static uint16_t FrameCRC;
+static uint8_t CobsRemaining;
+static bool CobsPendingZero;
+#endif
+
+#if defined(SPI_CHANNEL_SUPPORT)
+// SPI side channel bytes lost while the host did not read the endpoint
+static volatile uint16_t SPIDroppedBytes = 0;
+// set once the SPI endpoint is allocated, LUFA marks the device configured before the event handler runs
+static volatile bool SPIChannelReady = false;
+#endif
+
 // variable to determine if CDC baudrate is for the bootloader mode or not
 static volatile bool CDCActive = false;
 
+// a full packet was sent to the host and has to be followed by a zero length packet if no more data comes
+static bool ZLPPending = false;
+
 /** Current address counter. This stores the current address of the FLASH or EEPROM as set by the host,
  *  and is used when reading or writing to the AVRs memory (either FLASH or EEPROM depending on the issued
  *  command.)
  */
 static uint32_t CurrAddress;
 
+#if defined(PIPELINED_WRITE_SUPPORT)
+/** Flash page which was erased with a filled temporary page buffer, but not written yet. The write is started
+ *  as soon as the erase finished, while the next block is already received from the host.
+ */
+static uint32_t PendingPageAddress;
+static bool PageWritePending = false;
+
+// the next block is received into the USART transmit buffer, which is unused in bootloader mode
+#if (USBTOUSART_BUFFER_SIZE < SPM_PAGESIZE)
+#error The USB to USART buffer is too small to hold a flash page.
+#endif
+#endif
+
 /** Flag to indicate if the bootloader should be running, or should exit and allow the application code to run
  *  via a watchdog reset. When cleared the bootloader will exit, starting the watchdog and entering an infinite
  *  loop until the AVR restarts and the application runs.
@@ -110,6 +246,11 @@ volatile uint8_t *const MagicBootKeyPtr = (volatile uint8_t *)0x0280;
 // Bootloader timeout timer in ms
 #define EXT_RESET_TIMEOUT_PERIOD 750
 
+#if defined(EXT_RESET_TIMEOUT_EEPROM)
+// EEPROM byte with the double tap window in 10ms steps, the erased value 0xFF keeps the default timeout
+#define EXT_RESET_TIMEOUT_EEPROM_ADDR ((uint8_t*)E2END)
+#endif
+
 /** Special startup routine to check if the bootloader was started via a watchdog reset, and if the magic application
  *  start key has been loaded into \ref MagicBootKey. If the bootloader started via the watchdog and the key is valid,
  *  this will force the user application to start via a software jump.
@@ -139,8 +280,19 @@ void Application_Jump_Check(void)
 				// set the Bootkey and give the user a few ms chance to enter Bootloader mode
 				*MagicBootKeyPtr = MAGIC_BOOT_KEY;
 
+#if defined(EXT_RESET_TIMEOUT_EEPROM)
+				// wait for a possible double tab for the time configured in the EEPROM. With a value of 0 the sketch
+				// starts at once and the bootloader can only be entered with the magic key (1200 baud touch).
+				uint8_t Timeout = eeprom_read_byte(EXT_RESET_TIMEOUT_EEPROM_ADDR);
+				if (Timeout == 0xFF)
+					Timeout = EXT_RESET_TIMEOUT_PERIOD / 10;
+
+				while (Timeout--)
+					_delay_ms(10);
+#else
 				// wait for a possible double tab (this methode takes less flash than an ISR)
 				_delay_ms(EXT_RESET_TIMEOUT_PERIOD);
+#endif
 
 				// user was too slow/normal reset, start sketch now
 				*MagicBootKeyPtr = 0;
@@ -183,14 +335,30 @@ int main(void)
 	GlobalInterruptEnable();
 
 	do {
-		CDC_Task();
-		USB_USBTask();
+		{
+			PROFILE_START();
+			CDC_Task();
+			PROFILE_END(PROFILE_SLOT_CDC_Task);
+		}
+		{
+			PROFILE_START();
+			USB_USBTask();
+			PROFILE_END(PROFILE_SLOT_USB_USBTask);
+		}
 
 		// check Leds (this methode takes less flash than an ISR)
 		if (TIFR0 & (1 << TOV0)){
+			PROFILE_START();
+
 			// reset the timer
 			TIFR0 |= (1 << TOV0);
 
+#if defined(LATENCY_TIMER_SUPPORT)
+			// age of the last IN packet for the latency timer
+			if (LatencyTicks != 0xFF)
+				LatencyTicks++;
+#endif
+
 			// Turn off TX LED(s) once the TX pulse period has elapsed
 			if (TxLEDPulse && !(--TxLEDPulse))
 				LEDs_TurnOffLEDs(LEDMASK_TX);
@@ -198,6 +366,48 @@ int main(void)
 			// Turn off RX LED(s) once the RX pulse period has elapsed
 			if (RxLEDPulse && !(--RxLEDPulse))
 				LEDs_TurnOffLEDs(LEDMASK_RX);
+
+#if defined(SPI_CHANNEL_SUPPORT)
+			// send a partially filled bank of the SPI side channel
+			if (SPIChannelReady && (USB_DeviceState == DEVICE_STATE_Configured)){
+				uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+				GlobalInterruptDisable();
+
+				Endpoint_SelectEndpoint(SPI_CHANNEL_EPADDR);
+				if (Endpoint_IsINReady() && Endpoint_BytesInEndpoint())
+					Endpoint_ClearIN();
+
+				SetGlobalInterruptMask(CurrentGlobalInt);
+			}
+#endif
+
+#if defined(SERIAL_ERROR_SUPPORT)
+			// report new errors, but not more often than every SERIAL_ERROR_INTERVAL_MS
+			if (SerialErrorTicks)
+				SerialErrorTicks--;
+			else if (SerialErrorBits){
+				uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+				GlobalInterruptDisable();
+
+				uint8_t ErrorBits = SerialErrorBits;
+				SerialErrorBits = 0;
+
+				SetGlobalInterruptMask(CurrentGlobalInt);
+
+				SetSerialState(SerialState | ErrorBits);
+				SerialErrorTicks = SERIAL_ERROR_INTERVAL_MS;
+			}
+#endif
+
+#if defined(AUTO_RESET_PULSE_MS)
+			// release the main MCU from reset and tell the host that it is starting now
+			if (ResetPulseTicks && !(--ResetPulseTicks)){
+				AVR_RESET_LINE_PORT |= AVR_RESET_LINE_MASK;
+				SetSerialState(SerialState | CDC_CONTROL_LINE_IN_DSR);
+			}
+#endif
+
+			PROFILE_END(PROFILE_SLOT_LEDs);
 		}
 	} while (RunBootloader);
 
@@ -227,12 +437,33 @@ static void SetupHardware(void)
 	/* Initialize the USB and other board hardware drivers */
 	USB_Init();
 
-	/* Start the flush timer for Leds */
-	TCCR0B = (1 << CS02);
+	/* Start the flush timer for Leds and the latency timer, overflows every 1.024ms */
+	TCCR0B = (1 << CS01) | (1 << CS00);
+
+#if defined(HOODLOADER2_PROFILING) || defined(AUTOBAUD_SUPPORT) || defined(TIMESTAMP_SUPPORT)
+	/* Start the free running cycle counter for the profiling build, the baud rate measurement and the timestamps */
+	TCCR1B = (1 << CS10);
+#endif
+#if defined(TIMESTAMP_SUPPORT)
+	TIMSK1 = (1 << TOIE1);
+#endif
 
 	// compacter setup for Leds, RX, TX, Reset Line
 	ARDUINO_DDR |= LEDS_ALL_LEDS | (1 << PD3) | AVR_RESET_LINE_MASK;
 	ARDUINO_PORT |= LEDS_ALL_LEDS | (1 << 2) | AVR_RESET_LINE_MASK;
+
+#if defined(HARDWARE_FLOW_CONTROL)
+	// RTS output (low, ready to receive), CTS input with pullup (stopped until the main MCU pulls it low)
+	FLOW_CONTROL_DDR |= FLOW_CONTROL_RTS_MASK;
+	FLOW_CONTROL_PORT |= FLOW_CONTROL_CTS_MASK;
+#endif
+
+#if defined(SPI_CHANNEL_SUPPORT)
+	// SPI slave in mode 0, MISO output, SS pulled up so the channel is idle while the main MCU is not connected
+	DDRB |= (1 << PB3);
+	PORTB |= (1 << PB0);
+	SPCR = (1 << SPIE) | (1 << SPE);
+#endif
 }
 
 /** Event handler for the USB_ConfigurationChanged event. This configures the device's endpoints ready
@@ -240,6 +471,11 @@ static void SetupHardware(void)
  */
 void EVENT_USB_Device_ConfigurationChanged(void)
 {
+#if defined(SPI_CHANNEL_SUPPORT)
+	// endpoints have to be configured in ascending order
+	Endpoint_ConfigureEndpoint(SPI_CHANNEL_EPADDR, EP_TYPE_BULK, SPI_CHANNEL_EPSIZE, SPI_CHANNEL_BANK_SIZE);
+#endif
+
 	/* Setup CDC Notification, Rx and Tx Endpoints */
 	Endpoint_ConfigureEndpoint(CDC_NOTIFICATION_EPADDR, EP_TYPE_INTERRUPT,
 		CDC_NOTIFICATION_EPSIZE, 1);
@@ -247,14 +483,44 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 	Endpoint_ConfigureEndpoint(CDC_TX_EPADDR, EP_TYPE_BULK, CDC_TX_EPSIZE, CDC_TX_BANK_SIZE);
 
 	Endpoint_ConfigureEndpoint(CDC_RX_EPADDR, EP_TYPE_BULK, CDC_RX_EPSIZE, CDC_RX_BANK_SIZE);
+
+#if defined(SERIAL_STATE_SUPPORT)
+	// the endpoint is empty again after a (re)configuration
+	SerialStateNotification = 0;
+#endif
+
+#if defined(SPI_CHANNEL_SUPPORT)
+	SPIChannelReady = true;
+#endif
 }
 
+#if defined(SPI_CHANNEL_SUPPORT)
+/** Event handler for the USB_Reset event. The endpoints are freed, so the SPI channel must not write into them.
+ *  A suspend raises USB_Disconnect as well but keeps the configuration, so the channel only pauses while the device
+ *  state is not configured and continues after the resume.
+ */
+void EVENT_USB_Device_Reset(void)
+{
+	SPIChannelReady = false;
+}
+#endif
+
 /** Event handler for the USB_ControlRequest event. This is used to catch and process control requests sent to
  *  the device from the USB host before passing along unhandled control requests to the library for processing
  *  internally.
  */
 void EVENT_USB_Device_ControlRequest(void)
 {
+#if defined(BOOT_CONTROL_INTERFACE)
+	// vendor requests to the bootloader control interface
+	if ((USB_ControlRequest.bmRequestType == (REQDIR_DEVICETOHOST | REQTYPE_VENDOR | REQREC_INTERFACE)) &&
+		(USB_ControlRequest.wIndex == INTERFACE_ID_BOOTCTRL))
+	{
+		BootControl_ProcessRequest();
+		return;
+	}
+#endif
+
 	/* Ignore any requests that aren't directed to the CDC interface */
 	if ((USB_ControlRequest.bmRequestType & (CONTROL_REQTYPE_TYPE | CONTROL_REQTYPE_RECIPIENT)) !=
 		(REQTYPE_CLASS | REQREC_INTERFACE))
@@ -325,6 +591,213 @@ void EVENT_USB_Device_ControlRequest(void)
 			CDC_Device_LineEncodingChanged();
 		}
 	}
+#if defined(DROPPED_BYTES_SUPPORT)
+	else if (bRequest == HOODLOADER2_REQ_GetDroppedBytes){
+		if (USB_ControlRequest.bmRequestType == (REQDIR_DEVICETOHOST | REQTYPE_CLASS | REQREC_INTERFACE))
+		{
+			Endpoint_ClearSETUP();
+
+			// turn off interrupts to read the value properly
+			uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+			GlobalInterruptDisable();
+
+			uint16_t Dropped = DroppedBytes;
+
+			SetGlobalInterruptMask(CurrentGlobalInt);
+
+			/* Write the dropped byte counter to the control endpoint */
+			Endpoint_Write_Control_Stream_LE(&Dropped, sizeof(Dropped));
+			Endpoint_ClearOUT();
+		}
+	}
+#endif
+#if defined(EXACT_BAUDRATE_SUPPORT)
+	else if (bRequest == HOODLOADER2_REQ_GetBaudRate){
+		if (USB_ControlRequest.bmRequestType == (REQDIR_DEVICETOHOST | REQTYPE_CLASS | REQREC_INTERFACE))
+		{
+			Endpoint_ClearSETUP();
+
+			HoodLoader2_BaudRate_t BaudRate;
+			BaudRate.BaudRateBPS = (F_CPU / 8) / BaudDivider;
+			BaudRate.DoubleSpeed = (UCSR1A & (1 << U2X1)) ? 1 : 0;
+
+			/* Write the actual baud rate to the control endpoint */
+			Endpoint_Write_Control_Stream_LE(&BaudRate, sizeof(BaudRate));
+			Endpoint_ClearOUT();
+		}
+	}
+#endif
+#if defined(SERIAL_ERROR_SUPPORT)
+	else if (bRequest == HOODLOADER2_REQ_GetSerialErrors){
+		if (USB_ControlRequest.bmRequestType == (REQDIR_DEVICETOHOST | REQTYPE_CLASS | REQREC_INTERFACE))
+		{
+			Endpoint_ClearSETUP();
+
+			// turn off interrupts to read the values properly
+			HoodLoader2_SerialErrors_t Errors;
+
+			uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+			GlobalInterruptDisable();
+
+			memcpy(&Errors, (const void*)&SerialErrors, sizeof(Errors));
+
+			SetGlobalInterruptMask(CurrentGlobalInt);
+
+			/* Write the error counters to the control endpoint */
+			Endpoint_Write_Control_Stream_LE(&Errors, sizeof(Errors));
+			Endpoint_ClearOUT();
+		}
+	}
+#endif
+#if defined(TIMESTAMP_SUPPORT)
+	else if (bRequest == HOODLOADER2_REQ_SetTimestamps){
+		if (USB_ControlRequest.bmRequestType == (REQDIR_HOSTTODEVICE | REQTYPE_CLASS | REQREC_INTERFACE))
+		{
+			Endpoint_ClearSETUP();
+			Endpoint_ClearStatusStage();
+
+			// the buffered bytes have no burst records, so they are discarded
+			uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+			GlobalInterruptDisable();
+
+			TimestampMode = USB_ControlRequest.wValue;
+			TimestampCount = 0;
+#if defined(FRAMING_SUPPORT)
+			// both modes can not be used together
+			FramingMode = FRAMING_MODE_NONE;
+			FramedBytes = 0;
+			FrameLength = 0;
+			FrameDiscard = false;
+			Framing_Reset();
+#endif
+			BufferCount = 0;
+			BufferIndex = 0;
+			BufferEnd = 0;
+#if defined(HARDWARE_FLOW_CONTROL)
+			FLOW_CONTROL_PORT &= ~FLOW_CONTROL_RTS_MASK;
+#endif
+
+			SetGlobalInterruptMask(CurrentGlobalInt);
+		}
+	}
+#endif
+#if defined(FRAMING_SUPPORT)
+	else if (bRequest == HOODLOADER2_REQ_SetFraming){
+		if (USB_ControlRequest.bmRequestType == (REQDIR_HOSTTODEVICE | REQTYPE_CLASS | REQREC_INTERFACE))
+		{
+			Endpoint_ClearSETUP();
+			Endpoint_ClearStatusStage();
+
+			// the buffered bytes may end in the middle of a frame, so they are discarded
+			uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+			GlobalInterruptDisable();
+
+			FramingMode = USB_ControlRequest.wValue;
+#if defined(TIMESTAMP_SUPPORT)
+			TimestampMode = false;
+#endif
+			BufferCount = 0;
+			BufferIndex = 0;
+			BufferEnd = 0;
+			FramedBytes = 0;
+			FrameLength = 0;
+			FrameDiscard = false;
+			Framing_Reset();
+#if defined(HARDWARE_FLOW_CONTROL)
+			FLOW_CONTROL_PORT &= ~FLOW_CONTROL_RTS_MASK;
+#endif
+
+			SetGlobalInterruptMask(CurrentGlobalInt);
+		}
+	}
+	else if (bRequest == HOODLOADER2_REQ_GetDroppedFrames){
+		if (USB_ControlRequest.bmRequestType == (REQDIR_DEVICETOHOST | REQTYPE_CLASS | REQREC_INTERFACE))
+		{
+			Endpoint_ClearSETUP();
+
+			// turn off interrupts to read the value properly
+			uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+			GlobalInterruptDisable();
+
+			uint16_t Dropped = DroppedFrames;
+
+			SetGlobalInterruptMask(CurrentGlobalInt);
+
+			/* Write the dropped frame counter to the control endpoint */
+			Endpoint_Write_Control_Stream_LE(&Dropped, sizeof(Dropped));
+			Endpoint_ClearOUT();
+		}
+	}
+#endif
+#if defined(SPI_CHANNEL_SUPPORT)
+	else if (bRequest == HOODLOADER2_REQ_GetSPIDroppedBytes){
+		if (USB_ControlRequest.bmRequestType == (REQDIR_DEVICETOHOST | REQTYPE_CLASS | REQREC_INTERFACE))
+		{
+			Endpoint_ClearSETUP();
+
+			// turn off interrupts to read and clear the value properly
+			uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+			GlobalInterruptDisable();
+
+			uint16_t Dropped = SPIDroppedBytes;
+			SPIDroppedBytes = 0;
+
+			SetGlobalInterruptMask(CurrentGlobalInt);
+
+			/* Write the dropped byte counter to the control endpoint */
+			Endpoint_Write_Control_Stream_LE(&Dropped, sizeof(Dropped));
+			Endpoint_ClearOUT();
+		}
+	}
+#endif
+#if defined(LATENCY_TIMER_SUPPORT)
+	else if (bRequest == HOODLOADER2_REQ_SetLatencyTimer){
+		if (USB_ControlRequest.bmRequestType == (REQDIR_HOSTTODEVICE | REQTYPE_CLASS | REQREC_INTERFACE))
+		{
+			Endpoint_ClearSETUP();
+			Endpoint_ClearStatusStage();
+
+			// the timer only has 8 bit, longer latencies are limited instead of wrapping around
+			if (USB_ControlRequest.wValue > 0xFF)
+				LatencyTimerMS = 0xFF;
+			else
+				LatencyTimerMS = USB_ControlRequest.wValue;
+		}
+	}
+	else if (bRequest == HOODLOADER2_REQ_GetLatencyTimer){
+		if (USB_ControlRequest.bmRequestType == (REQDIR_DEVICETOHOST | REQTYPE_CLASS | REQREC_INTERFACE))
+		{
+			Endpoint_ClearSETUP();
+
+			/* Write the latency timer to the control endpoint */
+			Endpoint_Write_Control_Stream_LE(&LatencyTimerMS, sizeof(LatencyTimerMS));
+			Endpoint_ClearOUT();
+		}
+	}
+#endif
+#if defined(HOODLOADER2_PROFILING)
+	else if (bRequest == HOODLOADER2_REQ_GetProfile){
+		if (USB_ControlRequest.bmRequestType == (REQDIR_DEVICETOHOST | REQTYPE_CLASS | REQREC_INTERFACE))
+		{
+			Endpoint_ClearSETUP();
+
+			// take a consistent copy and start a new measurement interval
+			Profile_Counter_t Profile[PROFILE_SLOT_COUNT];
+
+			uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+			GlobalInterruptDisable();
+
+			memcpy(Profile, ProfileCounters, sizeof(Profile));
+			memset(ProfileCounters, 0, sizeof(ProfileCounters));
+
+			SetGlobalInterruptMask(CurrentGlobalInt);
+
+			/* Write the profiling counters to the control endpoint */
+			Endpoint_Write_Control_Stream_LE(Profile, sizeof(Profile));
+			Endpoint_ClearOUT();
+		}
+	}
+#endif
 	else if (bRequest == CDC_REQ_SetControlLineState){
 		if (USB_ControlRequest.bmRequestType == (REQDIR_HOSTTODEVICE | REQTYPE_CLASS | REQREC_INTERFACE))
 		{
@@ -335,36 +808,478 @@ void EVENT_USB_Device_ControlRequest(void)
 			// You could add the OUTPUT declaration here but it wont help since the pc always tries to open the serial port once.
 			// At least if the usb is connected this always results in a main MCU reset if the bootloader is executed.
 			// From my testings there is no way to avoid this. Its needed as far as I tested, no way.
+#if defined(AUTO_RESET_PULSE_MS)
+			// only a new DTR starts a fixed reset pulse, the Timer0 tick releases the reset line again.
+			// The timer is restarted, so the pulse is exactly AUTO_RESET_PULSE_MS ticks long.
+			bool DTR = !CDCActive && (USB_ControlRequest.wValue & CDC_CONTROL_LINE_OUT_DTR);
+			if (DTR && !LastDTR){
+				AVR_RESET_LINE_PORT &= ~AVR_RESET_LINE_MASK;
+				TCNT0 = 0;
+				TIFR0 |= (1 << TOV0);
+				ResetPulseTicks = AUTO_RESET_PULSE_MS;
+				SetSerialState(SerialState & ~CDC_CONTROL_LINE_IN_DSR);
+			}
+			LastDTR = DTR;
+#else
 			if (!CDCActive && USB_ControlRequest.wValue & CDC_CONTROL_LINE_OUT_DTR)
 				AVR_RESET_LINE_PORT &= ~AVR_RESET_LINE_MASK;
 			else
 				AVR_RESET_LINE_PORT |= AVR_RESET_LINE_MASK;
+#endif
 
 		}
 	}
 }
 
+#if defined(AUTOBAUD_SUPPORT)
+/** ISR to measure the baud rate from the edges on the RX line. The first edge only starts the measurement. */
+ISR(INT2_vect, ISR_BLOCK)
+{
+	uint16_t Now = TCNT1;
+	uint16_t Pulse = Now - AutobaudLastEdge;
+	AutobaudLastEdge = Now;
+
+	if (AutobaudEdges++ && (Pulse < AutobaudMinPulse))
+		AutobaudMinPulse = Pulse;
+
+	// enough edges seen, CDC_Task() switches to the measured baud rate
+	if (AutobaudEdges == AUTOBAUD_EDGES)
+		EIMSK &= ~(1 << INT2);
+}
+#endif
+
+#if defined(TIMESTAMP_SUPPORT)
+/** ISR to extend Timer1 to the 32 bit timestamps. */
+ISR(TIMER1_OVF_vect, ISR_BLOCK)
+{
+	TimestampHigh++;
+}
+
+/** Returns the 32 bit Timer1 timestamp in CPU cycles, interrupts have to be disabled. */
+static inline uint32_t Timestamp_Read(void)
+{
+	uint16_t Low = TCNT1;
+	uint16_t High = TimestampHigh;
+
+	// the overflow ISR is still pending if the timer just wrapped around
+	if ((TIFR1 & (1 << TOV1)) && (Low < 0x8000))
+		High++;
+
+	return ((uint32_t)High << 16) | Low;
+}
+
+/** Adds the received byte to the newest burst record, or starts a new one after a gap. Returns false if the byte
+ *  has to be dropped, because all records are in use.
+ */
+static inline bool Timestamp_TagByte(void)
+{
+	uint32_t Now = Timestamp_Read();
+	uint32_t Gap = Now - TimestampLastByte;
+	TimestampLastByte = Now;
+
+	uint8_t Count = TimestampCount;
+	Timestamp_Record_t* Record = &TimestampRecords[(uint8_t)(TimestampHead + Count - 1) % TIMESTAMP_RECORDS];
+
+	// start a new burst after a gap, or if the current one is full or already being sent
+	if (!Count || TimestampClosed || (Record->Length == TIMESTAMP_CHUNK_SIZE) || (Gap > TimestampGap)){
+		if (Count < TIMESTAMP_RECORDS){
+			Record = &TimestampRecords[(uint8_t)(TimestampHead + Count) % TIMESTAMP_RECORDS];
+			Record->Timestamp = Now;
+			Record->Length = 0;
+			TimestampCount = Count + 1;
+			TimestampClosed = false;
+		}
+		// no free record, the byte is dropped. It must not be added to the previous burst with its timestamp, and
+		// neither may the rest of its burst, so the previous one is closed.
+		else{
+			TimestampClosed = true;
+			return false;
+		}
+	}
+
+	Record->Length++;
+	return true;
+}
+#endif
+
+#if defined(FRAMING_SUPPORT)
+/** Starts the COBS decoder and the CRC for a new frame. */
+static inline void Framing_Reset(void)
+{
+	FrameCRC = 0;
+	CobsRemaining = 0;
+	CobsPendingZero = false;
+}
+
+/** Adds a received byte to the current COBS frame. A complete frame is released for the host, a corrupt or too
+ *  long frame is removed from the USART->USB buffer again.
+ */
+static inline void Framing_ReceiveByte(const uint8_t Data)
+{
+	// drop the rest of a frame that did not fit into the buffer
+	if (FrameDiscard){
+		if (!Data)
+			FrameDiscard = false;
+		return;
+	}
+
+	if (BufferCount >= BUFFER_SIZE){
+		// the incomplete frame can never be sent, remove it from the buffer
+		BufferEnd = (BufferEnd + BUFFER_SIZE - FrameLength) % BUFFER_SIZE;
+		BufferCount -= FrameLength;
+		FrameLength = 0;
+		FrameDiscard = (Data != 0);
+		Framing_Reset();
+
+		if (DroppedFrames != 0xFFFF)
+			DroppedFrames++;
+		return;
+	}
+
+	USARTtoUSB_Buffer_Data[BufferEnd++] = Data;
+
+	// increase the buffer position and wrap around if needed
+	BufferEnd %= BUFFER_SIZE;
+
+	// increase buffer count
+	BufferCount++;
+	FrameLength++;
+
+#if defined(HARDWARE_FLOW_CONTROL)
+	// ask the main MCU to stop sending before the buffer overflows. This only helps if complete frames can be
+	// drained, the unfinished frame alone must never be stopped or it could not be completed anymore.
+	if ((BufferCount >= FLOW_CONTROL_HIGH_WATERMARK) && FramedBytes)
+		FLOW_CONTROL_PORT |= FLOW_CONTROL_RTS_MASK;
+#endif
+
+	if (Data){
+		// decode the COBS data for the CRC. The zero at the end of a block is only added once more data follows,
+		// since the zero of the last block is not part of the frame.
+		if (!CobsRemaining){
+			if (CobsPendingZero)
+				FrameCRC = _crc_xmodem_update(FrameCRC, 0);
+
+			CobsRemaining = Data - 1;
+			CobsPendingZero = (Data != 0xFF);
+		}
+		else{
+			FrameCRC = _crc_xmodem_update(FrameCRC, Data);
+			CobsRemaining--;
+		}
+		return;
+	}
+
+	// the delimiter completes the frame, the CRC over the payload including the appended CRC has to be zero
+	bool Valid = (FramingMode != FRAMING_MODE_COBS_CRC16) || (!CobsRemaining && !FrameCRC && (FrameLength >= 4));
+
+	// empty frames are dropped silently
+	if (FrameLength > 1){
+		if (Valid){
+			FramedBytes += FrameLength;
+			FrameLength = 0;
+		}
+		else if (DroppedFrames != 0xFFFF)
+			DroppedFrames++;
+	}
+
+	// remove a dropped frame from the buffer again
+	BufferEnd = (BufferEnd + BUFFER_SIZE - FrameLength) % BUFFER_SIZE;
+	BufferCount -= FrameLength;
+	FrameLength = 0;
+	Framing_Reset();
+}
+#endif
+
+#if defined(BOOT_CONTROL_INTERFACE)
+/** Processes the vendor requests of the bootloader control interface. Each request only touches a single page,
+ *  so the main loop and the bridge are never stalled for long. Unknown requests are stalled by the USB core, and so
+ *  are the flash requests while the AVR109 bootloader is active. Re-enabling the RWW section would clear the
+ *  temporary page buffer that its byte wise flash commands may just be filling.
+ */
+static void BootControl_ProcessRequest(void)
+{
+	uint8_t bRequest = USB_ControlRequest.bRequest;
+	uint16_t Page = USB_ControlRequest.wValue;
+
+	if (bRequest == BOOTCTRL_REQ_GetInfo){
+		BootControl_Info_t Info;
+		Info.Signature[0] = AVR_SIGNATURE_1;
+		Info.Signature[1] = AVR_SIGNATURE_2;
+		Info.Signature[2] = AVR_SIGNATURE_3;
+		Info.LowFuse = boot_lock_fuse_bits_get(GET_LOW_FUSE_BITS);
+		Info.HighFuse = boot_lock_fuse_bits_get(GET_HIGH_FUSE_BITS);
+		Info.ExtendedFuse = boot_lock_fuse_bits_get(GET_EXTENDED_FUSE_BITS);
+		Info.LockBits = boot_lock_fuse_bits_get(GET_LOCK_BITS);
+		Info.VersionMajor = BOOTLOADER_VERSION_MAJOR;
+		Info.VersionMinor = BOOTLOADER_VERSION_MINOR;
+		Info.PageSize = SPM_PAGESIZE;
+		Info.BootStartAddress = BOOT_START_ADDR;
+
+		Endpoint_ClearSETUP();
+
+		/* Write the device information to the control endpoint */
+		Endpoint_Write_Control_Stream_LE(&Info, sizeof(Info));
+		Endpoint_ClearOUT();
+	}
+	else if (!CDCActive && (Page < ((FLASHEND + 1UL) / SPM_PAGESIZE))){
+		uint16_t PageAddress = Page * SPM_PAGESIZE;
+
+		// the RWW section can only be read once a pending or running page write has finished
+#if defined(PIPELINED_WRITE_SUPPORT)
+		FinishPageWrite();
+#else
+		boot_spm_busy_wait();
+#endif
+		boot_rww_enable();
+
+		if (bRequest == BOOTCTRL_REQ_ReadFlashPage){
+			Endpoint_ClearSETUP();
+
+			/* Write the flash page to the control endpoint, the host may read less */
+			Endpoint_Write_Control_PStream_LE((const void*)PageAddress, SPM_PAGESIZE);
+			Endpoint_ClearOUT();
+		}
+		else if (bRequest == BOOTCTRL_REQ_GetPageCRC){
+			uint16_t CRC = 0;
+			for (uint16_t i = 0; i < SPM_PAGESIZE; i++)
+				CRC = _crc_xmodem_update(CRC, pgm_read_byte(PageAddress + i));
+
+			Endpoint_ClearSETUP();
+
+			/* Write the checksum to the control endpoint */
+			Endpoint_Write_Control_Stream_LE(&CRC, sizeof(CRC));
+			Endpoint_ClearOUT();
+		}
+	}
+}
+#endif
+
+#if defined(SPI_CHANNEL_SUPPORT)
+/** ISR to write the bytes of the SPI side channel directly into the USB endpoint. A full bank is sent at once,
+ *  the main loop sends a partially filled bank every ms. The endpoint selection of the main loop is restored.
+ */
+ISR(SPI_STC_vect, ISR_BLOCK)
+{
+	uint8_t ReceivedByte = SPDR;
+
+	if (!SPIChannelReady || (USB_DeviceState != DEVICE_STATE_Configured))
+		return;
+
+	uint8_t PrevEndpoint = Endpoint_GetCurrentEndpoint();
+	Endpoint_SelectEndpoint(SPI_CHANNEL_EPADDR);
+
+	if (Endpoint_IsINReady()){
+		Endpoint_Write_8(ReceivedByte);
+
+		if (!Endpoint_IsReadWriteAllowed())
+			Endpoint_ClearIN();
+	}
+	// both banks are waiting for the host
+	else if (SPIDroppedBytes != 0xFFFF)
+		SPIDroppedBytes++;
+
+	Endpoint_SelectEndpoint(PrevEndpoint);
+}
+#endif
+
 /** ISR to manage the reception of data from the serial port, placing received bytes into a circular buffer
 *  for later transmission to the host.
 */
 ISR(USART1_RX_vect, ISR_BLOCK)
 {
+	PROFILE_START();
+
+#if defined(SERIAL_ERROR_SUPPORT)
+	// the error flags belong to the byte in UDR1 and have to be read first
+	uint8_t Status = UCSR1A;
+	if (Status & ((1 << FE1) | (1 << DOR1) | (1 << UPE1))){
+		if (Status & (1 << FE1)){
+			SerialErrorBits |= CDC_CONTROL_LINE_IN_FRAMEERROR;
+			if (SerialErrors.FrameErrors != 0xFFFF)
+				SerialErrors.FrameErrors++;
+		}
+		if (Status & (1 << UPE1)){
+			SerialErrorBits |= CDC_CONTROL_LINE_IN_PARITYERROR;
+			if (SerialErrors.ParityErrors != 0xFFFF)
+				SerialErrors.ParityErrors++;
+		}
+		if (Status & (1 << DOR1)){
+			SerialErrorBits |= CDC_CONTROL_LINE_IN_OVERRUNERROR;
+			if (SerialErrors.Overruns != 0xFFFF)
+				SerialErrors.Overruns++;
+		}
+	}
+#endif
+
 	// read the newest byte from the UART, important to clear interrupt flag!
 	uint8_t ReceivedByte = UDR1;
 
-	// only save the new byte if USB device is ready and buffer is not full
-	if (!CDCActive && (USB_DeviceState == DEVICE_STATE_Configured) && (BufferCount < BUFFER_SIZE)){
-		// save new byte
-		USARTtoUSB_Buffer_Data[BufferEnd++] = ReceivedByte;
+	// only save the new byte if USB device is ready
+	if (!CDCActive && (USB_DeviceState == DEVICE_STATE_Configured)){
+#if defined(FRAMING_SUPPORT)
+		if (FramingMode)
+			Framing_ReceiveByte(ReceivedByte);
+		else
+#endif
+		// save new byte if buffer is not full (and a burst record is free in the timestamped framing mode)
+#if defined(TIMESTAMP_SUPPORT)
+		if ((BufferCount < BUFFER_SIZE) && (!TimestampMode || Timestamp_TagByte())){
+#else
+		if (BufferCount < BUFFER_SIZE){
+#endif
+			USARTtoUSB_Buffer_Data[BufferEnd++] = ReceivedByte;
+
+			// increase the buffer position and wrap around if needed
+			BufferEnd %= BUFFER_SIZE;
+
+			// increase buffer count
+			BufferCount++;
+
+#if defined(HARDWARE_FLOW_CONTROL)
+			// ask the main MCU to stop sending before the buffer overflows
+			if (BufferCount >= FLOW_CONTROL_HIGH_WATERMARK)
+				FLOW_CONTROL_PORT |= FLOW_CONTROL_RTS_MASK;
+#endif
+		}
+#if defined(SERIAL_ERROR_SUPPORT) || defined(DROPPED_BYTES_SUPPORT)
+		// count the lost byte so the host can tell overruns of the bridge apart
+		else{
+#if defined(SERIAL_ERROR_SUPPORT)
+			SerialErrorBits |= CDC_CONTROL_LINE_IN_OVERRUNERROR;
+#endif
+#if defined(DROPPED_BYTES_SUPPORT)
+			if (DroppedBytes != 0xFFFF)
+				DroppedBytes++;
+#endif
+		}
+#endif
+	}
+
+	PROFILE_END(PROFILE_SLOT_USART_RX_ISR);
+}
+
+#if defined(USART_TX_BUFFER_SUPPORT)
+/** ISR to manage the transmission of data to the serial port, sending bytes from the circular buffer filled
+*  with the data received from the host. The interrupt disables itself once the buffer has been emptied.
+*/
+ISR(USART1_UDRE_vect, ISR_BLOCK)
+{
+	PROFILE_START();
+
+	uint8_t Count = USBtoUSART_BufferCount;
+
+#if defined(HARDWARE_FLOW_CONTROL)
+	// pause while the main MCU is not ready, CDC_Task() restarts the interrupt
+	if (FLOW_CONTROL_PIN & FLOW_CONTROL_CTS_MASK)
+		Count = 0;
+#endif
+
+	if (Count){
+		// send the oldest byte to the UART
+		UDR1 = USBtoUSART_Buffer_Data[USBtoUSART_BufferIndex++];
 
 		// increase the buffer position and wrap around if needed
-		BufferEnd %= BUFFER_SIZE;
+		USBtoUSART_BufferIndex %= USBTOUSART_BUFFER_SIZE;
 
-		// increase buffer count
-		BufferCount++;
+		// decrease buffer count
+		USBtoUSART_BufferCount = --Count;
 	}
+
+	// stop the interrupt when all data has been sent
+	if (!Count)
+		UCSR1B &= ~(1 << UDRIE1);
+
+	PROFILE_END(PROFILE_SLOT_USART_UDRE_ISR);
+}
+#endif
+
+#if defined(SERIAL_STATE_SUPPORT)
+/** Changes the serial state and queues a SERIAL_STATE notification. A notification that is already half sent
+ *  is not restarted, its second packet will carry the new state.
+ */
+static void SetSerialState(const uint16_t State)
+{
+	SerialState = State;
+
+	if (!SerialStateNotification)
+		SerialStateNotification = 1;
+}
+
+/** Sends the next packet of a queued SERIAL_STATE notification if the notification endpoint is free. */
+static void SendSerialState(void)
+{
+	if (!SerialStateNotification || (USB_DeviceState != DEVICE_STATE_Configured))
+		return;
+
+	Endpoint_SelectEndpoint(CDC_NOTIFICATION_EPADDR);
+
+	if (!Endpoint_IsINReady())
+		return;
+
+	if (SerialStateNotification == 1){
+		USB_Request_Header_t Notification = (USB_Request_Header_t)
+		{
+			.bmRequestType = (REQDIR_DEVICETOHOST | REQTYPE_CLASS | REQREC_INTERFACE),
+			.bRequest      = CDC_NOTIF_SerialState,
+			.wValue        = CPU_TO_LE16(0),
+			.wIndex        = CPU_TO_LE16(INTERFACE_ID_CDC_CCI),
+			.wLength       = CPU_TO_LE16(sizeof(SerialState)),
+		};
+
+		// the header fills the whole 8 byte endpoint
+		uint8_t* Data = (uint8_t*)&Notification;
+		for (uint8_t i = 0; i < sizeof(Notification); i++)
+			Endpoint_Write_8(Data[i]);
+
+		SerialStateNotification = 2;
+	}
+	else{
+		Endpoint_Write_16_LE(SerialState);
+		SerialStateNotification = 0;
+
+		// the error bits are irregular signals and only reported once
+		SerialState &= ~(CDC_CONTROL_LINE_IN_FRAMEERROR | CDC_CONTROL_LINE_IN_PARITYERROR | CDC_CONTROL_LINE_IN_OVERRUNERROR);
+	}
+
+	Endpoint_ClearIN();
+}
+#endif
+
+#if defined(HOODLOADER2_PROFILING)
+/** Reads the free running Timer1 of the profiling build. The 16 bit read has to be atomic, because the ISRs use
+ *  the shared TEMP register of the timer as well.
+ *
+ *  \return Current CPU cycle count, modulo 2^16
+ */
+static uint16_t Profile_Timestamp(void)
+{
+	uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+	GlobalInterruptDisable();
+
+	uint16_t Timestamp = TCNT1;
+
+	SetGlobalInterruptMask(CurrentGlobalInt);
+
+	return Timestamp;
 }
 
+/** Adds a finished measurement to the counters of a hot path.
+ *
+ *  \param[in] Slot   Hot path to account the cycles to, a value of \ref Profile_Slots
+ *  \param[in] Start  Timestamp taken with \ref Profile_Timestamp() when the hot path was entered
+ */
+static void Profile_Record(const uint8_t Slot, const uint16_t Start)
+{
+	uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+	GlobalInterruptDisable();
+
+	ProfileCounters[Slot].Cycles += (uint16_t)(TCNT1 - Start);
+	ProfileCounters[Slot].Calls++;
+
+	SetGlobalInterruptMask(CurrentGlobalInt);
+}
+#endif
+
 /** Retrieves the next byte from the host in the CDC data OUT endpoint, and clears the endpoint bank if needed
  *  to allow reception of the next data packet from the host.
  *
@@ -384,6 +1299,11 @@ static uint8_t FetchNextCommandByte(void)
 		{
 			if (USB_DeviceState == DEVICE_STATE_Unattached)
 				return 0;
+
+#if defined(PIPELINED_WRITE_SUPPORT)
+			// write the previous page while the host sends the next block
+			StartPageWrite();
+#endif
 		}
 	}
 
@@ -422,19 +1342,53 @@ static void WriteNextResponseByte(const uint8_t Response)
  */
 static void CDC_Task(void)
 {
+#if defined(PIPELINED_WRITE_SUPPORT)
+	StartPageWrite();
+#endif
+
 	/* Select the OUT endpoint */
 	Endpoint_SelectEndpoint(CDC_RX_EPADDR);
 
 	/* Check if endpoint has a command in it sent from the host */
 	if (Endpoint_IsOUTReceived()){
 
-		/* Read in the bootloader command (first byte sent from host) */
-		uint8_t Command = FetchNextCommandByte();
-
 		// USB-Serial Mode
 		if (!CDCActive){
+#if defined(USART_TX_BUFFER_SUPPORT)
+			uint8_t BytesInEndpoint = Endpoint_BytesInEndpoint();
+
+			// only take the whole packet if it fits into the USART transmit buffer, otherwise the host gets NAKed
+			// until the ISR sent enough data. The count can only decrease in the meantime.
+			if (BytesInEndpoint <= (USBTOUSART_BUFFER_SIZE - USBtoUSART_BufferCount)){
+				/* Store received bytes into the USART transmit buffer */
+				uint8_t BytesToRead = BytesInEndpoint;
+				while (BytesToRead--){
+					USBtoUSART_Buffer_Data[USBtoUSART_BufferEnd++] = Endpoint_Read_8();
+
+					// increase the buffer position and wrap around if needed
+					USBtoUSART_BufferEnd %= USBTOUSART_BUFFER_SIZE;
+				}
+
+				// acknowledge the packet to the host, the bank can be filled again now
+				Endpoint_ClearOUT();
+
+				// turn off interrupts to save the value properly
+				uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+				GlobalInterruptDisable();
+
+				// increase buffer count and let the ISR send the new data
+				USBtoUSART_BufferCount += BytesInEndpoint;
+				UCSR1B |= (1 << UDRIE1);
+
+				SetGlobalInterruptMask(CurrentGlobalInt);
+
+				// Turn on RX LED
+				LEDs_TurnOnLEDs(LEDMASK_RX);
+				RxLEDPulse = TX_RX_LED_PULSE_MS;
+			}
+#else
 			/* Store received byte into the USART transmit buffer */
-			Serial_SendByte(Command);
+			Serial_SendByte(FetchNextCommandByte());
 
 			// if endpoint is completely empty/read acknowledge that to the host
 			if (!(Endpoint_BytesInEndpoint()))
@@ -443,67 +1397,258 @@ static void CDC_Task(void)
 			// Turn on RX LED
 			LEDs_TurnOnLEDs(LEDMASK_RX);
 			RxLEDPulse = TX_RX_LED_PULSE_MS;
+#endif
 		}
 
 		// Bootloader Mode
-		else
+		else{
+			/* Read in the bootloader command (first byte sent from host) */
+			uint8_t Command = FetchNextCommandByte();
 			Bootloader_Task(Command);
+
+			/* Send the response to the host */
+			FlushCDC();
+
+			/* Select the OUT endpoint */
+			Endpoint_SelectEndpoint(CDC_RX_EPADDR);
+
+			/* Acknowledge the command from the host */
+			Endpoint_ClearOUT();
+		}
 	}
-	// nothing received in Bootloader mode
-	else if (CDCActive)
+
+	// nothing to send in Bootloader mode
+	if (CDCActive)
 		return;
 
+#if defined(AUTOBAUD_SUPPORT)
+	// switch to the measured baud rate, rounded to the nearest rate the USART can reach
+	if (AutobaudEdges == AUTOBAUD_EDGES){
+		uint16_t Divider = (AutobaudMinPulse + 4) / 8;
+		if (!Divider)
+			Divider = 1;
+
+		LineEncoding.BaudRateBPS = (F_CPU / 8) / Divider;
+		CDC_Device_LineEncodingChanged();
+	}
+#endif
+
+#if defined(SERIAL_STATE_SUPPORT)
+	SendSerialState();
+#endif
+
+#if defined(HARDWARE_FLOW_CONTROL)
+	// restart the transmission once the main MCU is ready again
+	if (USBtoUSART_BufferCount && !(FLOW_CONTROL_PIN & FLOW_CONTROL_CTS_MASK)){
+		uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+		GlobalInterruptDisable();
+
+		UCSR1B |= (1 << UDRIE1);
+
+		SetGlobalInterruptMask(CurrentGlobalInt);
+	}
+#endif
+
+	/* Select the IN endpoint */
+	Endpoint_SelectEndpoint(CDC_TX_EPADDR);
+
+	// dont wait for the host here. With the double banked endpoint the second bank is normally free
+	// while the host reads the first one. If both are busy the data stays in the buffer for the next pass.
+	if (!Endpoint_IsINReady())
+		return;
+
+#if defined(TIMESTAMP_SUPPORT)
+	if (TimestampMode){
+		SendTimestampChunks();
+		return;
+	}
+#endif
+
 	// get the number of bytes in the USB-Serial Buffer
-	uint8_t BytesToSend;
+	BufferCount_t BytesToSend;
 
 	uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
 	GlobalInterruptDisable();
 
-	// Buffercount is 0 in Bootloader mode!
+	// snapshot the count once, the ISR can only add more data in the meantime
+#if defined(FRAMING_SUPPORT)
+	// only whole frames are sent, so every transfer ends at a frame boundary
+	if (FramingMode)
+		BytesToSend = FramedBytes;
+	else
+#endif
 	BytesToSend = BufferCount;
 
 	SetGlobalInterruptMask(CurrentGlobalInt);
 
-	// dont try to flush data in USB-Serial mode if there is no data. This will block the USB
-	if (!CDCActive){
-		if (!BytesToSend)
-			return;
-		else{
-			// Turn on TX LED
-			LEDs_TurnOnLEDs(LEDMASK_TX);
-			TxLEDPulse = TX_RX_LED_PULSE_MS;
+#if defined(LATENCY_TIMER_SUPPORT)
+	// coalesce small writes into bigger packets until the latency timer expires
+	if ((BytesToSend < CDC_TX_EPSIZE) && (LatencyTicks < LatencyTimerMS))
+		return;
+#endif
+
+	if (!BytesToSend){
+		// a transfer that ended with a full packet needs a zero length packet to complete on the host
+		if (ZLPPending){
+			Endpoint_ClearIN();
+			ZLPPending = false;
 		}
+		return;
 	}
 
+	// Turn on TX LED
+	LEDs_TurnOnLEDs(LEDMASK_TX);
+	TxLEDPulse = TX_RX_LED_PULSE_MS;
+
 	// Read bytes from the USART receive buffer into the USB IN endpoint, max 1 bank size
-	while (BytesToSend--){
-		// Write the Data to the Endpoint */
-		WriteNextResponseByte(USARTtoUSB_Buffer_Data[BufferIndex++]);
+	if (BytesToSend > CDC_TX_EPSIZE)
+		BytesToSend = CDC_TX_EPSIZE;
 
-		// increase the buffer position and wrap around if needed
-		BufferIndex %= BUFFER_SIZE;
+	WriteUSARTBuffer(BytesToSend);
+	ReleaseUSARTBuffer(BytesToSend);
 
-		// turn off interrupts to save the value properly
-		uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+	// Remember if the endpoint is completely full before clearing it
+	ZLPPending = !(Endpoint_IsReadWriteAllowed());
+
+	// Send the endpoint data to the host, the next pass can already fill the other bank
+	Endpoint_ClearIN();
+
+#if defined(LATENCY_TIMER_SUPPORT)
+	// restart the latency timer
+	LatencyTicks = 0;
+#endif
+}
+
+#if defined(TIMESTAMP_SUPPORT)
+/** Sends as many whole bursts as fit into the selected IN endpoint, each as a chunk with its timestamp. */
+static void SendTimestampChunks(void)
+{
+	uint8_t Count = TimestampCount;
+
+#if defined(LATENCY_TIMER_SUPPORT)
+	// coalesce bursts into bigger packets until the latency timer expires or all records are used
+	if ((Count < TIMESTAMP_RECORDS) && (LatencyTicks < LatencyTimerMS))
+		return;
+#endif
+
+	if (!Count){
+		// a transfer that ended with a full packet needs a zero length packet to complete on the host
+		if (ZLPPending){
+			Endpoint_ClearIN();
+			ZLPPending = false;
+		}
+		return;
+	}
+
+	// Turn on TX LED
+	LEDs_TurnOnLEDs(LEDMASK_TX);
+	TxLEDPulse = TX_RX_LED_PULSE_MS;
+
+	// the newest burst must not grow while it is sent, new bytes start another one
+	uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+	GlobalInterruptDisable();
+
+	TimestampClosed = true;
+
+	SetGlobalInterruptMask(CurrentGlobalInt);
+
+	uint8_t Space = CDC_TX_EPSIZE;
+	while (Count--){
+		Timestamp_Record_t* Record = &TimestampRecords[TimestampHead];
+		uint8_t Length = Record->Length;
+
+		// the first chunk always fits
+		if ((Length + 5) > Space)
+			break;
+		Space -= Length + 5;
+
+		Endpoint_Write_8(Length);
+		Endpoint_Write_32_LE(Record->Timestamp);
+		WriteUSARTBuffer(Length);
+
+		// free the record and its data
+		CurrentGlobalInt = GetGlobalInterruptMask();
 		GlobalInterruptDisable();
 
-		// decrease buffer count
-		BufferCount--;
+		TimestampHead = (TimestampHead + 1) % TIMESTAMP_RECORDS;
+		TimestampCount--;
+
+		SetGlobalInterruptMask(CurrentGlobalInt);
+
+		ReleaseUSARTBuffer(Length);
+	}
+
+	// Remember if the endpoint is completely full before clearing it
+	ZLPPending = !(Endpoint_IsReadWriteAllowed());
+
+	// Send the endpoint data to the host, the next pass can already fill the other bank
+	Endpoint_ClearIN();
+
+#if defined(LATENCY_TIMER_SUPPORT)
+	// restart the latency timer
+	LatencyTicks = 0;
+#endif
+}
+#endif
+
+/** Writes bytes from the USART->USB buffer into the selected IN endpoint, which must have enough space left. */
+static void WriteUSARTBuffer(uint8_t BytesToSend)
+{
+#if defined(BLOCK_COPY_SUPPORT)
+	// Copy the data in contiguous runs, at most two are needed if the buffer wraps around
+	while (BytesToSend){
+		BufferCount_t Run = BUFFER_SIZE - BufferIndex;
+		if (Run > BytesToSend)
+			Run = BytesToSend;
+		BytesToSend -= Run;
+
+		uint8_t* Data = &USARTtoUSB_Buffer_Data[BufferIndex];
+
+		// increase the buffer position and wrap around if needed
+		BufferIndex = (BufferIndex + Run) % BUFFER_SIZE;
+
+		// Write the Data to the Endpoint, it is still selected and has enough space left
+		while (Run--)
+			Endpoint_Write_8(*Data++);
+	}
+#else
+	while (BytesToSend--){
+		// Write the Data to the Endpoint, it is still selected and has enough space left
+		Endpoint_Write_8(USARTtoUSB_Buffer_Data[BufferIndex++]);
 
-		SetGlobalInterruptMask(CurrentGlobalInt);
+		// increase the buffer position and wrap around if needed
+		BufferIndex %= BUFFER_SIZE;
 	}
+#endif
+}
 
-	FlushCDC();
+/** Frees the bytes written by \ref WriteUSARTBuffer() for the ISR. */
+static void ReleaseUSARTBuffer(uint8_t BytesSent)
+{
+	// turn off interrupts to save the value properly
+	uint_reg_t CurrentGlobalInt = GetGlobalInterruptMask();
+	GlobalInterruptDisable();
 
-	// in Bootloader mode clear the Out endpoint
-	if (CDCActive){
+	// decrease buffer count once for the whole packet
+	BufferCount -= BytesSent;
+#if defined(FRAMING_SUPPORT)
+	if (FramingMode)
+		FramedBytes -= BytesSent;
+#endif
 
-		/* Select the OUT endpoint */
-		Endpoint_SelectEndpoint(CDC_RX_EPADDR);
+#if defined(HARDWARE_FLOW_CONTROL)
+	// let the main MCU continue once the buffer has been drained far enough, or once all complete frames have
+	// been sent, since the unfinished frame can only be sent after it was completed
+	bool Release = (BufferCount <= FLOW_CONTROL_LOW_WATERMARK);
+#if defined(FRAMING_SUPPORT)
+	if (FramingMode && !FramedBytes)
+		Release = true;
+#endif
+	if (Release)
+		FLOW_CONTROL_PORT &= ~FLOW_CONTROL_RTS_MASK;
+#endif
 
-		/* Acknowledge the command from the host */
-		Endpoint_ClearOUT();
-	}
+	SetGlobalInterruptMask(CurrentGlobalInt);
 }
 
 static void FlushCDC(void){
@@ -538,6 +1683,13 @@ static void FlushCDC(void){
 }
 
 static void Bootloader_Task(const uint8_t Command){
+#if defined(PIPELINED_WRITE_SUPPORT)
+	// finish a pipelined page write before the flash is accessed, only the next block may overlap with it
+	if ((Command != AVR109_COMMAND_BlockWrite) && (Command != AVR109_COMMAND_StreamWriteFlash) &&
+		(Command != AVR109_COMMAND_CompressedWriteFlash) && (Command != AVR109_COMMAND_SetCurrentAddress))
+		FinishPageWrite();
+#endif
+
 	if (Command == AVR109_COMMAND_ExitBootloader)
 	{
 		RunBootloader = false;
@@ -603,17 +1755,25 @@ static void Bootloader_Task(const uint8_t Command){
 	else if (Command == AVR109_COMMAND_EraseFLASH)
 	{
 		/* Clear the application section of flash */
-		for (uint32_t CurrFlashAddress = 0; CurrFlashAddress < (uint32_t)BOOT_START_ADDR; CurrFlashAddress += SPM_PAGESIZE)
-		{
-			boot_page_erase(CurrFlashAddress);
-			boot_spm_busy_wait();
-			boot_page_write(CurrFlashAddress);
-			boot_spm_busy_wait();
-		}
+		EraseFlashRange(0, BOOT_START_ADDR);
+
+		/* Send confirmation byte back to the host */
+		WriteNextResponseByte('\r');
+	}
+#if defined(ERASE_RANGE_SUPPORT)
+	else if (Command == AVR109_COMMAND_EraseFlashPages)
+	{
+		/* Number of flash pages to erase from the current address on */
+		uint16_t Pages = (FetchNextCommandByte() << 8);
+		Pages |= FetchNextCommandByte();
+
+		/* Only clear the span the host is about to program */
+		EraseFlashRange(CurrAddress, CurrAddress + ((uint32_t)Pages * SPM_PAGESIZE));
 
 		/* Send confirmation byte back to the host */
 		WriteNextResponseByte('\r');
 	}
+#endif
 #if !defined(NO_LOCK_BYTE_WRITE_SUPPORT)
 	else if (Command == AVR109_COMMAND_WriteLockbits)
 	{
@@ -654,6 +1814,148 @@ static void Bootloader_Task(const uint8_t Command){
 		/* Delegate the block write/read to a separate function for clarity */
 		ReadWriteMemoryBlock(Command);
 	}
+#if defined(STREAM_WRITE_SUPPORT)
+	else if (Command == AVR109_COMMAND_StreamWriteFlash)
+	{
+		/* Total number of bytes to program from the (page aligned) current address on */
+		uint16_t BytesLeft = (FetchNextCommandByte() << 8);
+		BytesLeft |= FetchNextCommandByte();
+
+		uint8_t Response = '\r';
+
+		/* Split the stream at the page boundaries, each page is pipelined with the reception of the next one */
+		while (BytesLeft)
+		{
+			uint16_t BlockSize = SPM_PAGESIZE;
+			if (BlockSize > BytesLeft)
+				BlockSize = BytesLeft;
+			BytesLeft -= BlockSize;
+
+			/* The rest of the stream is still received after a rejected page to stay in sync with the host */
+			if (!WriteFlashBlock(BlockSize))
+				Response = '?';
+		}
+
+		/* Send a single confirmation byte for the whole stream back to the host */
+		WriteNextResponseByte(Response);
+	}
+#endif
+#if defined(COMPRESSED_WRITE_SUPPORT)
+	else if (Command == AVR109_COMMAND_CompressedWriteFlash)
+	{
+		/* Size of the compressed stream, it is decoded into flash pages from the (page aligned) current address on */
+		uint16_t BytesLeft = (FetchNextCommandByte() << 8);
+		BytesLeft |= FetchNextCommandByte();
+
+		uint16_t PageFill = 0;
+		uint8_t  Response = '\r';
+
+		while (BytesLeft)
+		{
+			/* A token is either a literal run of 1-128 bytes or a match of 3-130 bytes with a 16 bit big endian distance */
+			uint8_t  Token = FetchNextCommandByte();
+			uint8_t  Length = (Token & 0x7F) + 1;
+			uint16_t Distance = 0;
+			BytesLeft--;
+
+			if (Token & 0x80)
+			{
+				/* Stop on a truncated stream */
+				if (BytesLeft < 2)
+					break;
+				BytesLeft -= 2;
+
+				Length += 2;
+				Distance = (FetchNextCommandByte() << 8);
+				Distance |= FetchNextCommandByte();
+
+				/* A match without a distance is malformed, drop the rest of the stream to stay in sync with the host */
+				if (!Distance)
+				{
+					while (BytesLeft--)
+						FetchNextCommandByte();
+
+					Response = '?';
+					break;
+				}
+			}
+			else
+			{
+				/* Never read past the stream */
+				if (Length > BytesLeft)
+					Length = BytesLeft;
+				BytesLeft -= Length;
+			}
+
+			while (Length--)
+			{
+				uint8_t Data;
+
+				if (!Distance)
+					Data = FetchNextCommandByte();
+				else if (Distance <= PageFill)
+					Data = USBtoUSART_Buffer_Data[PageFill - Distance];
+				else
+				{
+					/* The match starts in an earlier page, which has to be programmed before it can be read back */
+					FinishPageWrite();
+					boot_rww_enable();
+#if (FLASHEND > 0xFFFF)
+					Data = pgm_read_byte_far(CurrAddress + PageFill - Distance);
+#else
+					Data = pgm_read_byte(CurrAddress + PageFill - Distance);
+#endif
+				}
+
+				USBtoUSART_Buffer_Data[PageFill++] = Data;
+
+				/* Program every completed page, the next one is decoded while it is written */
+				if (PageFill == SPM_PAGESIZE)
+				{
+					if (!ProgramFlashPage(SPM_PAGESIZE))
+						Response = '?';
+					PageFill = 0;
+				}
+			}
+		}
+
+		/* Program the last partial page */
+		if (PageFill && !ProgramFlashPage(PageFill))
+			Response = '?';
+
+		/* Send a single confirmation byte for the whole stream back to the host */
+		WriteNextResponseByte(Response);
+	}
+#endif
+#if defined(PAGE_CRC_SUPPORT)
+	else if (Command == AVR109_COMMAND_ReadFlashPageCRC)
+	{
+		/* Number of flash pages to checksum */
+		uint16_t Pages = (FetchNextCommandByte() << 8);
+		Pages |= FetchNextCommandByte();
+
+		/* Re-enable RWW section */
+		boot_rww_enable();
+
+		while (Pages--)
+		{
+			uint16_t CRC = 0;
+
+			/* Checksum the next FLASH page, the host can compare it against its image instead of reading it back */
+			for (uint16_t CurrByte = 0; CurrByte < SPM_PAGESIZE; CurrByte++)
+			{
+#if (FLASHEND > 0xFFFF)
+				CRC = _crc_xmodem_update(CRC, pgm_read_byte_far(CurrAddress++));
+#else
+				CRC = _crc_xmodem_update(CRC, pgm_read_byte(CurrAddress++));
+#endif
+			}
+
+			WriteNextResponseByte(CRC >> 8);
+			WriteNextResponseByte(CRC & 0xFF);
+		}
+	}
+#endif
 #endif
 #if !defined(NO_FLASH_BYTE_SUPPORT)
 	else if (Command == AVR109_COMMAND_FillFlashPageWordHigh)
@@ -701,8 +2003,8 @@ static void Bootloader_Task(const uint8_t Command){
 #if !defined(NO_EEPROM_BYTE_SUPPORT)
 	else if (Command == AVR109_COMMAND_WriteEEPROM)
 	{
-		/* Read the byte from the endpoint and write it to the EEPROM */
-		eeprom_write_byte((uint8_t*)((intptr_t)(CurrAddress >> 1)), FetchNextCommandByte());
+		/* Read the byte from the endpoint and write it to the EEPROM, unless it is already stored */
+		eeprom_update_byte((uint8_t*)((intptr_t)(CurrAddress >> 1)), FetchNextCommandByte());
 
 		/* Increment the address after use */
 		CurrAddress += 2;
@@ -726,6 +2028,46 @@ static void Bootloader_Task(const uint8_t Command){
 	}
 }
 
+/** Erases the application flash pages in the given range. With BLANK_PAGE_SKIP_SUPPORT pages which are already
+ *  blank are skipped, since most of the application section is usually empty.
+ *
+ *  \param[in] StartAddress  Byte address of the first page to erase
+ *  \param[in] EndAddress    Byte address behind the last page to erase, limited to the start of the bootloader
+ */
+static void EraseFlashRange(uint32_t StartAddress, uint32_t EndAddress)
+{
+	/* Never erase the bootloader itself */
+	if (EndAddress > (uint32_t)BOOT_START_ADDR)
+		EndAddress = BOOT_START_ADDR;
+
+	for (uint32_t CurrFlashAddress = (StartAddress & ~(SPM_PAGESIZE - 1)); CurrFlashAddress < EndAddress; CurrFlashAddress += SPM_PAGESIZE)
+	{
+#if defined(BLANK_PAGE_SKIP_SUPPORT)
+		/* Re-enable RWW section to check the page */
+		boot_rww_enable();
+
+		for (uint16_t CurrByte = 0; CurrByte < SPM_PAGESIZE; CurrByte += 2)
+		{
+#if (FLASHEND > 0xFFFF)
+			if (pgm_read_word_far(CurrFlashAddress + CurrByte) != 0xFFFF)
+#else
+			if (pgm_read_word(CurrFlashAddress + CurrByte) != 0xFFFF)
+#endif
+			{
+				/* An erased page is blank already, no page write is needed afterwards */
+				boot_page_erase(CurrFlashAddress);
+				boot_spm_busy_wait();
+				break;
+			}
+		}
+#else
+		/* An erased page is blank already, no page write is needed afterwards */
+		boot_page_erase(CurrFlashAddress);
+		boot_spm_busy_wait();
+#endif
+	}
+}
+
 #if !defined(NO_BLOCK_SUPPORT)
 /** Reads or writes a block of EEPROM or FLASH memory to or from the appropriate CDC data endpoint, depending
 *  on the AVR109 protocol command issued.
@@ -737,9 +2079,6 @@ static void ReadWriteMemoryBlock(const uint8_t Command)
 	uint16_t BlockSize;
 	char     MemoryType;
 
-	uint8_t  HighByte = 0;
-	uint8_t  LowByte = 0;
-
 	BlockSize = (FetchNextCommandByte() << 8);
 	BlockSize |= FetchNextCommandByte();
 
@@ -759,9 +2098,56 @@ static void ReadWriteMemoryBlock(const uint8_t Command)
 		/* Re-enable RWW section */
 		boot_rww_enable();
 
-		while (BlockSize--)
+		if (MemoryType == MEMORY_TYPE_FLASH)
 		{
-			if (MemoryType == MEMORY_TYPE_FLASH)
+#if defined(BURST_READ_SUPPORT)
+			/* The data is streamed from a separate pointer, only completely read words increment the address counter */
+#if (FLASHEND > 0xFFFF)
+			uint32_t ReadAddress = CurrAddress;
+#else
+			uint16_t ReadAddress = CurrAddress;
+#endif
+			CurrAddress += (BlockSize & ~1);
+
+			/* Select the IN endpoint so that the data can be written */
+			Endpoint_SelectEndpoint(CDC_TX_EPADDR);
+
+			/* Fill whole packets straight from the FLASH, reads may be larger than a page */
+			while (BlockSize)
+			{
+				/* If IN endpoint full, clear it and wait until ready for the next packet to the host */
+				if (!(Endpoint_IsReadWriteAllowed()))
+				{
+					Endpoint_ClearIN();
+
+					while (!(Endpoint_IsINReady()))
+					{
+						if (USB_DeviceState == DEVICE_STATE_Unattached)
+							return;
+					}
+				}
+
+				uint8_t BytesToWrite = CDC_TX_EPSIZE - Endpoint_BytesInEndpoint();
+				if (BytesToWrite > BlockSize)
+					BytesToWrite = BlockSize;
+				BlockSize -= BytesToWrite;
+
+				while (BytesToWrite--)
+				{
+					/* Read the next FLASH byte and post increment the pointer */
+#if (FLASHEND > 0xFFFF)
+					Endpoint_Write_8(pgm_read_byte_far(ReadAddress++));
+#else
+					uint8_t Data;
+					__asm__ __volatile__ ("lpm %0, Z+" : "=r" (Data), "=z" (ReadAddress) : "1" (ReadAddress));
+					Endpoint_Write_8(Data);
+#endif
+				}
+			}
+#else
+			uint8_t HighByte = 0;
+
+			while (BlockSize--)
 			{
 				/* Read the next FLASH byte from the current FLASH page */
 #if (FLASHEND > 0xFFFF)
@@ -776,7 +2162,11 @@ static void ReadWriteMemoryBlock(const uint8_t Command)
 
 				HighByte = !HighByte;
 			}
-			else
+#endif
+		}
+		else
+		{
+			while (BlockSize--)
 			{
 				/* Read the next EEPROM byte into the endpoint */
 				WriteNextResponseByte(eeprom_read_byte((uint8_t*)(intptr_t)(CurrAddress >> 1)));
@@ -786,54 +2176,69 @@ static void ReadWriteMemoryBlock(const uint8_t Command)
 			}
 		}
 	}
-	else
+	else if (MemoryType == MEMORY_TYPE_FLASH)
 	{
-		uint32_t PageStartAddress = CurrAddress;
-
-		if (MemoryType == MEMORY_TYPE_FLASH)
+#if defined(PIPELINED_WRITE_SUPPORT)
+		/* Program the block as a single flash page */
+		if (!WriteFlashBlock(BlockSize))
 		{
-			boot_page_erase(PageStartAddress);
-			boot_spm_busy_wait();
+			WriteNextResponseByte('?');
+			return;
 		}
+#else
+		uint32_t PageStartAddress = CurrAddress;
+
+		uint8_t  HighByte = 0;
+		uint8_t  LowByte = 0;
+
+		boot_page_erase(PageStartAddress);
+		boot_spm_busy_wait();
 
 		while (BlockSize--)
 		{
-			if (MemoryType == MEMORY_TYPE_FLASH)
+			/* If both bytes in current word have been written, increment the address counter */
+			if (HighByte)
 			{
-				/* If both bytes in current word have been written, increment the address counter */
-				if (HighByte)
-				{
-					/* Write the next FLASH word to the current FLASH page */
-					boot_page_fill(CurrAddress, ((FetchNextCommandByte() << 8) | LowByte));
-
-					/* Increment the address counter after use */
-					CurrAddress += 2;
-				}
-				else
-				{
-					LowByte = FetchNextCommandByte();
-				}
+				/* Write the next FLASH word to the current FLASH page */
+				boot_page_fill(CurrAddress, ((FetchNextCommandByte() << 8) | LowByte));
 
-				HighByte = !HighByte;
+				/* Increment the address counter after use */
+				CurrAddress += 2;
 			}
 			else
 			{
-				/* Write the next EEPROM byte from the endpoint */
-				eeprom_write_byte((uint8_t*)((intptr_t)(CurrAddress >> 1)), FetchNextCommandByte());
-
-				/* Increment the address counter after use */
-				CurrAddress += 2;
+				LowByte = FetchNextCommandByte();
 			}
+
+			HighByte = !HighByte;
 		}
 
-		/* If in FLASH programming mode, commit the page after writing */
-		if (MemoryType == MEMORY_TYPE_FLASH)
+		/* Commit the flash page to memory */
+		boot_page_write(PageStartAddress);
+
+		/* Wait until write operation has completed */
+		boot_spm_busy_wait();
+#endif
+
+		/* Send response byte back to the host */
+		WriteNextResponseByte('\r');
+	}
+	else
+	{
+#if defined(PIPELINED_WRITE_SUPPORT)
+		/* An EEPROM write would discard the temporary page buffer of a pending flash page */
+		FinishPageWrite();
+#endif
+
+		while (BlockSize--)
 		{
-			/* Commit the flash page to memory */
-			boot_page_write(PageStartAddress);
+			/* Write the next EEPROM byte from the endpoint. Unchanged bytes are skipped. A write is only
+			 * started, not waited for, so the next byte is fetched from the host while the EEPROM is busy.
+			 */
+			eeprom_update_byte((uint8_t*)((intptr_t)(CurrAddress >> 1)), FetchNextCommandByte());
 
-			/* Wait until write operation has completed */
-			boot_spm_busy_wait();
+			/* Increment the address counter after use */
+			CurrAddress += 2;
 		}
 
 		/* Send response byte back to the host */
@@ -842,6 +2247,140 @@ static void ReadWriteMemoryBlock(const uint8_t Command)
 }
 #endif
 
+#if defined(PIPELINED_WRITE_SUPPORT)
+/** Receives a block of up to one flash page from the host and programs it at the current address. The page is
+ *  only erased and written if its content changes. The write is pipelined, the function returns before the page
+ *  has been programmed, so the host can already send the next block, see \ref FinishPageWrite().
+ *
+ *  \param[in] BlockSize  Number of bytes to receive from the host
+ *
+ *  \return Boolean \c false if the block was received but not programmed, see \ref ProgramFlashPage()
+ */
+static bool WriteFlashBlock(uint16_t BlockSize)
+{
+	/* Receive the block into SRAM while the previous page is still being erased and written */
+	uint8_t* PageData = USBtoUSART_Buffer_Data;
+	uint16_t BytesToRead = BlockSize;
+
+	while (BytesToRead--)
+	{
+		uint8_t Data = FetchNextCommandByte();
+
+		/* Never write past the buffer, the host should not send more than the reported block size */
+		if (PageData < &USBtoUSART_Buffer_Data[SPM_PAGESIZE])
+			*PageData++ = Data;
+	}
+
+	if (BlockSize > SPM_PAGESIZE)
+		BlockSize = SPM_PAGESIZE;
+
+	return ProgramFlashPage(BlockSize);
+}
+
+/** Programs the block in the SRAM page buffer as flash page at the current address. The page is only erased and
+ *  written if its content changes. The write is pipelined, see \ref FinishPageWrite().
+ *
+ *  \param[in] BlockSize  Number of bytes in the SRAM page buffer, at most one flash page
+ *
+ *  \return Boolean \c false if the current address is not the start of an application flash page, nothing is
+ *          programmed and the address is left unchanged then
+ */
+static bool ProgramFlashPage(uint16_t BlockSize)
+{
+	uint32_t PageStartAddress = CurrAddress;
+	uint8_t* PageData = USBtoUSART_Buffer_Data;
+
+	/* A page write always starts at the page boundary, and the bootloader must not overwrite itself */
+	if ((PageStartAddress & (SPM_PAGESIZE - 1)) || (PageStartAddress >= BOOT_START_ADDR))
+		return false;
+
+	/* The temporary page buffer can only be filled once the previous page has been written */
+	FinishPageWrite();
+
+	/* Only full words are written, a single trailing byte is ignored */
+	BlockSize &= ~1;
+
+	/* Skip the erase and write if the flash already contains the same page */
+	if (IsPageUnchanged(PageStartAddress, BlockSize))
+	{
+		CurrAddress += BlockSize;
+		return true;
+	}
+
+	/* Fill the temporary page buffer, it is kept during the following page erase */
+	for (BlockSize /= 2; BlockSize; BlockSize--)
+	{
+		/* Write the next FLASH word to the current FLASH page */
+		boot_page_fill(CurrAddress, (PageData[1] << 8) | PageData[0]);
+		PageData += 2;
+
+		/* Increment the address counter after use */
+		CurrAddress += 2;
+	}
+
+	/* Erase the page and let StartPageWrite() commit it once the erase has finished */
+	boot_page_erase(PageStartAddress);
+	PendingPageAddress = PageStartAddress;
+	PageWritePending = true;
+
+	return true;
+}
+
+/** Compares a received block with the flash page it would be written to. The rest of the page is erased when the
+ *  block is written, so it has to be blank as well for the page to be unchanged.
+ *
+ *  \param[in] PageStartAddress  Byte address of the flash page
+ *  \param[in] BlockSize         Number of received bytes in the SRAM page buffer
+ *
+ *  \return Boolean \c true if the page does not need to be erased and written again
+ */
+static bool IsPageUnchanged(const uint32_t PageStartAddress, const uint16_t BlockSize)
+{
+	/* Re-enable RWW section to read back the current page */
+	boot_rww_enable();
+
+	for (uint16_t CurrByte = 0; CurrByte < SPM_PAGESIZE; CurrByte++)
+	{
+		uint8_t Data = (CurrByte < BlockSize) ? USBtoUSART_Buffer_Data[CurrByte] : 0xFF;
+
+#if (FLASHEND > 0xFFFF)
+		if (pgm_read_byte_far(PageStartAddress + CurrByte) != Data)
+#else
+		if (pgm_read_byte(PageStartAddress + CurrByte) != Data)
+#endif
+			return false;
+	}
+
+	return true;
+}
+
+/** Starts the write of a pipelined flash page once its erase has finished, without waiting for it. */
+static void StartPageWrite(void)
+{
+	if (PageWritePending && !boot_spm_busy()){
+		boot_page_write(PendingPageAddress);
+		PageWritePending = false;
+	}
+}
+
+/** Waits until a pipelined flash page has been erased and written, so the flash can be accessed again. */
+static void FinishPageWrite(void)
+{
+	/* Wait until the page erase has completed */
+	boot_spm_busy_wait();
+
+	if (PageWritePending)
+	{
+		/* Commit the flash page to memory */
+		boot_page_write(PendingPageAddress);
+		PageWritePending = false;
+
+		/* Wait until write operation has completed */
+		boot_spm_busy_wait();
+	}
+}
+#endif
+
 /** Event handler for the CDC Class driver Line Encoding Changed event.
 *
 *  \param[in] CDCInterfaceInfo  Pointer to the CDC class interface configuration structure being referenced
@@ -855,10 +2394,37 @@ static void CDC_Device_LineEncodingChanged(void)
 	else
 		CDCActive = false;
 
-	// reset buffer
+	// reset buffers, a pending transmit ISR disables itself with an empty buffer
 	BufferCount = 0;
 	BufferIndex = 0;
 	BufferEnd = 0;
+#if defined(DROPPED_BYTES_SUPPORT)
+	DroppedBytes = 0;
+#endif
+#if defined(TIMESTAMP_SUPPORT)
+	TimestampCount = 0;
+#endif
+#if defined(FRAMING_SUPPORT)
+	FramedBytes = 0;
+	FrameLength = 0;
+	FrameDiscard = false;
+	DroppedFrames = 0;
+	Framing_Reset();
+#endif
+#if defined(SERIAL_ERROR_SUPPORT)
+	memset((void*)&SerialErrors, 0, sizeof(SerialErrors));
+	SerialErrorBits = 0;
+#endif
+
+#if defined(HARDWARE_FLOW_CONTROL)
+	// the buffer is empty again, let the main MCU send
+	FLOW_CONTROL_PORT &= ~FLOW_CONTROL_RTS_MASK;
+#endif
+#if defined(USART_TX_BUFFER_SUPPORT)
+	USBtoUSART_BufferCount = 0;
+	USBtoUSART_BufferIndex = 0;
+	USBtoUSART_BufferEnd = 0;
+#endif
 
 	uint8_t ConfigMask = 0;
 
@@ -896,14 +2462,61 @@ static void CDC_Device_LineEncodingChanged(void)
 	UCSR1A = 0;
 	UCSR1C = 0;
 
+#if defined(EXACT_BAUDRATE_SUPPORT)
+	// Find the closest divider in units of 8 CPU cycles per bit, which is the resolution of the double speed mode.
+	// The normal mode is used whenever it reaches the same rate (even divider), since its receiver samples every
+	// bit 16 times and tolerates more clock error. Very low rates only fit into the 12 bit UBRR in normal mode.
+	uint16_t Divider = 8192;
+	if (BaudRateBPS > ((F_CPU / 8) / 8192))
+		Divider = ((F_CPU / 4) / BaudRateBPS + 1) / 2;
+	if (!Divider)
+		Divider = 1;
+
+	uint8_t SpeedMask = 0;
+	if ((Divider & 1) && (Divider <= 4096))
+		SpeedMask = (1 << U2X1);
+	else
+		Divider &= ~1;
+	BaudDivider = Divider;
+
+	/* Set the new baud rate before configuring the USART */
+	if (SpeedMask)
+		UBRR1 = Divider - 1;
+	else
+		UBRR1 = (Divider / 2) - 1;
+#else
+	// the divider in units of 8 CPU cycles per bit is the double speed UBRR value plus one
+	uint16_t Divider = SERIAL_2X_UBBRVAL(BaudRateBPS) + 1;
+	uint8_t SpeedMask = (1 << U2X1);
+
 	/* Set the new baud rate before configuring the USART */
-	UBRR1 = SERIAL_2X_UBBRVAL(BaudRateBPS);
+	UBRR1 = Divider - 1;
+#endif
+
+#if defined(TIMESTAMP_SUPPORT)
+	// a new burst starts after a gap of two characters (20 bits)
+	TimestampGap = (uint32_t)Divider * 8 * 20;
+#endif
 
-	/* Reconfigure the USART in double speed mode for a wider baud rate range at the expense of accuracy */
+	/* Reconfigure the USART */
 	UCSR1C = ConfigMask;
-	UCSR1A = (1 << U2X1);
+	UCSR1A = SpeedMask;
 	UCSR1B = ((1 << RXCIE1) | (1 << TXEN1) | (1 << RXEN1));
 
+#if defined(AUTOBAUD_SUPPORT)
+	// measure the baud rate with the receiver turned off, the edges on RX trigger INT2 instead
+	AutobaudEdges = 0;
+	if (BaudRateBPS == AUTOBAUD_BAUDRATE){
+		UCSR1B = (1 << TXEN1);
+		AutobaudMinPulse = 0xFFFF;
+		EICRA = (EICRA & ~((1 << ISC21) | (1 << ISC20))) | (1 << ISC20);
+		EIFR = (1 << INTF2);
+		EIMSK |= (1 << INT2);
+	}
+	else
+		EIMSK &= ~(1 << INT2);
+#endif
+
 	/* Release the TX line after the USART has been reconfigured */
 	PORTD &= ~(1 << 3);
 }
\ No newline at end of file
@@ -75,12 +75,25 @@ along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
 		#include <LUFA/Drivers/Peripheral/Serial.h>
 		#include <LUFA/Drivers/Board/Board.h>
 		#include <util/delay.h>
+		#include <util/crc16.h>
 
 	/* Preprocessor Checks: */
 		#if !defined(__OPTIMIZE_SIZE__)
 			#error This bootloader requires that it be optimized for size, not speed, to fit into the target device. Change optimization settings and try again.
 		#endif
 
+		#if defined(HARDWARE_FLOW_CONTROL) && !defined(USART_TX_BUFFER_SUPPORT)
+			#error The hardware flow control requires USART_TX_BUFFER_SUPPORT to pause the transmission.
+		#endif
+
+		#if defined(PIPELINED_WRITE_SUPPORT) && defined(NO_BLOCK_SUPPORT)
+			#error The pipelined flash write requires the block commands, remove NO_BLOCK_SUPPORT.
+		#endif
+
+		#if (defined(STREAM_WRITE_SUPPORT) || defined(COMPRESSED_WRITE_SUPPORT)) && !defined(PIPELINED_WRITE_SUPPORT)
+			#error The streaming and the compressed flash write require PIPELINED_WRITE_SUPPORT.
+		#endif
+
 	/* Macros: */
 		/** Version major of the CDC bootloader. */
 		#define BOOTLOADER_VERSION_MAJOR     0x01
@@ -104,6 +117,20 @@ along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
 		#define ARDUINO_PORT PORTD
 		#define ARDUINO_DDR DDRD
 
+		/** Profiling build (make PROFILE=1), measures the hot paths with the free running Timer1. A single
+		 *  measurement has to be shorter than one Timer1 overflow (4ms).
+		 */
+		#if defined(HOODLOADER2_PROFILING)
+			#define PROFILE_START()              uint16_t ProfileStart = Profile_Timestamp()
+			#define PROFILE_END(Slot)            Profile_Record(Slot, ProfileStart)
+		#else
+			#define PROFILE_START()
+			#define PROFILE_END(Slot)
+		#endif
+
+		/** Maximum data bytes of a timestamped chunk, the 5 byte header and the data always fit into one IN packet. */
+		#define TIMESTAMP_CHUNK_SIZE         (CDC_TX_EPSIZE - 5)
+
 	/* Enums: */
 		/** Possible memory types that can be addressed via the bootloader. */
 		enum AVR109_Memories
@@ -145,12 +172,106 @@ along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
 			AVR109_COMMAND_SetLED                   = 'x',
 			AVR109_COMMAND_ClearLED                 = 'y',
 			AVR109_COMMAND_ExitBootloader           = 'E',
+
+			/* HoodLoader2 extensions */
+			AVR109_COMMAND_ReadFlashPageCRC         = 'k', /**< 'k' <pages MSB> <pages LSB>, returns a big endian CRC16 (XMODEM) per flash page from the current address on. */
+			AVR109_COMMAND_EraseFlashPages          = 'f', /**< 'f' <pages MSB> <pages LSB>, erases the non blank flash pages from the current address on. */
+			AVR109_COMMAND_StreamWriteFlash         = 'W', /**< 'W' <size MSB> <size LSB> <data>, programs a multi page flash image and returns a single '\r' ('?' for an unaligned or bootloader address). */
+			AVR109_COMMAND_CompressedWriteFlash     = 'Z', /**< 'Z' <size MSB> <size LSB> <data>, like 'W' with a compressed image, see tools/HoodLoader2_Compressor. */
+		};
+
+		/** HoodLoader2 specific class requests on the CDC control interface, outside of the range used by the CDC specification. */
+		enum HoodLoader2_Requests
+		{
+			HOODLOADER2_REQ_GetDroppedBytes         = 0xC0, /**< Returns the 16 bit saturating count of USART bytes lost to a full buffer since the last line encoding change (DROPPED_BYTES_SUPPORT). */
+			HOODLOADER2_REQ_SetLatencyTimer         = 0xC1, /**< Sets the IN packet latency timer to wValue ms, at most 255 (0 sends every byte at once, LATENCY_TIMER_SUPPORT). */
+			HOODLOADER2_REQ_GetLatencyTimer         = 0xC2, /**< Returns the 8 bit IN packet latency timer in ms (LATENCY_TIMER_SUPPORT). */
+			HOODLOADER2_REQ_GetProfile              = 0xC3, /**< Returns and clears the \ref Profile_Counter_t array of the profiling build. */
+			HOODLOADER2_REQ_GetBaudRate             = 0xC4, /**< Returns the \ref HoodLoader2_BaudRate_t the USART actually runs with (EXACT_BAUDRATE_SUPPORT). */
+			HOODLOADER2_REQ_GetSerialErrors         = 0xC5, /**< Returns the \ref HoodLoader2_SerialErrors_t counters since the last line encoding change. */
+			HOODLOADER2_REQ_SetTimestamps           = 0xC6, /**< Turns the timestamped framing mode on (wValue 1) or off (wValue 0), buffered data is discarded.
+			                                                 *   In this mode each chunk starts with an 8 bit length and the 32 bit little endian timestamp. */
+			HOODLOADER2_REQ_SetFraming              = 0xC7, /**< Sets the \ref HoodLoader2_Framing_Modes in wValue, buffered data is discarded. */
+			HOODLOADER2_REQ_GetDroppedFrames        = 0xC8, /**< Returns the 16 bit saturating count of corrupt or too long frames since the last line encoding change. */
+			HOODLOADER2_REQ_GetSPIDroppedBytes      = 0xC9, /**< Returns and clears the 16 bit saturating count of SPI side channel bytes lost while both banks were full. */
+		};
+
+		/** Vendor requests (device to host) on the bootloader control interface. */
+		enum BootControl_Requests
+		{
+			BOOTCTRL_REQ_GetInfo       = 0x01, /**< Returns the \ref BootControl_Info_t. */
+			BOOTCTRL_REQ_ReadFlashPage = 0x02, /**< Returns the flash page with the index in wValue, stalled in bootloader mode. */
+			BOOTCTRL_REQ_GetPageCRC    = 0x03, /**< Returns the 16 bit CRC (XMODEM) of the flash page with the index in wValue, stalled in bootloader mode. */
+		};
+
+		/** Packet framing modes of the USART->USB direction, set with \ref HOODLOADER2_REQ_SetFraming. */
+		enum HoodLoader2_Framing_Modes
+		{
+			FRAMING_MODE_NONE       = 0, /**< Raw byte stream. */
+			FRAMING_MODE_COBS       = 1, /**< Whole COBS frames only. */
+			FRAMING_MODE_COBS_CRC16 = 2, /**< Whole COBS frames with a valid CRC-16 only. */
+		};
+
+		/** Hot paths measured by the profiling build (make PROFILE=1). */
+		enum Profile_Slots
+		{
+			PROFILE_SLOT_CDC_Task                   = 0,
+			PROFILE_SLOT_USB_USBTask                = 1,
+			PROFILE_SLOT_LEDs                       = 2,
+			PROFILE_SLOT_USART_RX_ISR               = 3,
+			PROFILE_SLOT_USART_UDRE_ISR             = 4,
+			PROFILE_SLOT_COUNT                      = 5,
 		};
 
 	/* Type Defines: */
 		/** Type define for a non-returning pointer to the start of the loaded application in flash memory. */
 		typedef void (*AppPtr_t)(void) ATTR_NO_RETURN;
 
+		/** Type define for the counters of a single hot path in the profiling build, sent little endian to the host. */
+		typedef struct
+		{
+			uint32_t Cycles; /**< Sum of all CPU cycles spent in the function, including nested interrupts. */
+			uint32_t Calls;  /**< Number of invocations of the function. */
+		} Profile_Counter_t;
+
+		/** Type define for the baud rate the USART runs with. The error of the requested rate can be calculated from
+		 *  it, since the USART can only reach rates of F_CPU / (8 * n).
+		 */
+		typedef struct
+		{
+			uint32_t BaudRateBPS; /**< Achieved baud rate. */
+			uint8_t  DoubleSpeed; /**< 1 if the USART runs in double speed (U2X) mode. */
+		} ATTR_PACKED HoodLoader2_BaudRate_t;
+
+		/** Type define for the saturating USART error counters, bytes lost to a full buffer are counted separately. */
+		typedef struct
+		{
+			uint16_t FrameErrors;  /**< Bytes received with a wrong stop bit. */
+			uint16_t ParityErrors; /**< Bytes received with a wrong parity bit. */
+			uint16_t Overruns;     /**< Reception of the USART overran before the ISR read the data. */
+		} HoodLoader2_SerialErrors_t;
+
+		/** Type define for the device information of the bootloader control interface, sent little endian. */
+		typedef struct
+		{
+			uint8_t  Signature[3];     /**< AVR signature bytes. */
+			uint8_t  LowFuse;          /**< Low fuse byte. */
+			uint8_t  HighFuse;         /**< High fuse byte. */
+			uint8_t  ExtendedFuse;     /**< Extended fuse byte. */
+			uint8_t  LockBits;         /**< Lock bits. */
+			uint8_t  VersionMajor;     /**< Bootloader version, as reported by the AVR109 version command. */
+			uint8_t  VersionMinor;
+			uint16_t PageSize;         /**< Flash page size in bytes. */
+			uint32_t BootStartAddress; /**< Start of the bootloader, the application section ends here. */
+		} ATTR_PACKED BootControl_Info_t;
+
+		/** Type define for a burst of bytes in the USART->USB buffer in the timestamped framing mode. */
+		typedef struct
+		{
+			uint32_t Timestamp; /**< Timer1 time in CPU cycles when the first byte was received. */
+			uint8_t  Length;    /**< Number of bytes in the burst, at most \ref TIMESTAMP_CHUNK_SIZE. */
+		} Timestamp_Record_t;
+
 	/* Function Prototypes: */
 		static void CDC_Task(void);
 		static void Bootloader_Task(const uint8_t Command);
@@ -162,13 +283,46 @@ along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
 		void Application_Jump_Check(void) ATTR_INIT_SECTION(3);
 
 		void EVENT_USB_Device_ConfigurationChanged(void);
+		#if defined(SPI_CHANNEL_SUPPORT)
+		void EVENT_USB_Device_Reset(void);
+		#endif
 
 		#if defined(INCLUDE_FROM_BOOTLOADERCDC_C) || defined(__DOXYGEN__)
+			static void    EraseFlashRange(uint32_t StartAddress, uint32_t EndAddress);
 			#if !defined(NO_BLOCK_SUPPORT)
 			static void    ReadWriteMemoryBlock(const uint8_t Command);
 			#endif
+			#if defined(PIPELINED_WRITE_SUPPORT)
+			static bool    WriteFlashBlock(uint16_t BlockSize);
+			static bool    ProgramFlashPage(uint16_t BlockSize);
+			static void    StartPageWrite(void);
+			static void    FinishPageWrite(void);
+			static bool    IsPageUnchanged(const uint32_t PageStartAddress, const uint16_t BlockSize);
+			#endif
 			static uint8_t FetchNextCommandByte(void);
 			static void    WriteNextResponseByte(const uint8_t Response);
+			static void    WriteUSARTBuffer(uint8_t BytesToSend);
+			static void    ReleaseUSARTBuffer(uint8_t BytesSent);
+			#if defined(TIMESTAMP_SUPPORT)
+			static inline uint32_t Timestamp_Read(void) ATTR_ALWAYS_INLINE;
+			static inline bool     Timestamp_TagByte(void) ATTR_ALWAYS_INLINE;
+			static void            SendTimestampChunks(void);
+			#endif
+			#if defined(BOOT_CONTROL_INTERFACE)
+			static void            BootControl_ProcessRequest(void);
+			#endif
+			#if defined(FRAMING_SUPPORT)
+			static inline void     Framing_ReceiveByte(const uint8_t Data) ATTR_ALWAYS_INLINE;
+			static inline void     Framing_Reset(void) ATTR_ALWAYS_INLINE;
+			#endif
+			#if defined(SERIAL_STATE_SUPPORT)
+			static void    SetSerialState(const uint16_t State);
+			static void    SendSerialState(void);
+			#endif
+			#if defined(HOODLOADER2_PROFILING)
+			static uint16_t Profile_Timestamp(void);
+			static void     Profile_Record(const uint8_t Slot, const uint16_t Start);
+			#endif
 		#endif
 
 #endif
@@ -0,0 +1,603 @@
+/*
+Copyright(c) 2014-2015 NicoHood
+See the readme for credit to other people.
+
+This file is part of Hoodloader2.
+
+Hoodloader2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Hoodloader2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+ *
+ *  Host test of the HoodLoader2 bootloader logic. HoodLoader2.c is compiled for the PC against the stand-ins in
+ *  Stubs/, with a simulated flash that follows the SPM rules of the AVR: the temporary page buffer is cleared by
+ *  a page write and by re-enabling the RWW section, and the RWW section cannot be read or programmed while a page
+ *  erase or write is running. The test covers
+ *   - the compressed flash write 'Z' with an image from tools/HoodLoader2_Compressor, and the streaming write 'W'
+ *   - the rejection of unaligned and bootloader addresses by the page writes
+ *   - the COBS/CRC-16 framing of the USART receive ISR
+ *   - the baud rate divider and speed mode selection
+ *
+ *  Usage: "HostTest --image <file>" writes the test image, "HostTest <image> <compressed image>" runs the tests.
+ *  See the makefile, "make test" runs both steps with the compressor in between.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define main HoodLoader2_main
+#include "../HoodLoader2.c"
+#undef main
+
+#define HOSTTEST_DEFINE_REG8(Name)  volatile uint8_t Name;
+#define HOSTTEST_DEFINE_REG16(Name) volatile uint16_t Name;
+HOSTTEST_REGISTERS(HOSTTEST_DEFINE_REG8, HOSTTEST_DEFINE_REG16)
+
+/** Number of failed checks, the exit code of the test. */
+static unsigned Failures = 0;
+
+#define CHECK(Condition, ...) do { if (!(Condition)) { Failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+                                   printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+/* Simulated flash and self programming unit */
+static uint8_t  Flash[FLASHEND + 1];
+static uint16_t PageBuffer[SPM_PAGESIZE / 2];
+static bool     SPMBusy;
+static bool     RWWBusy;
+static unsigned SPMViolations;
+static unsigned PageErases;
+static unsigned PageWrites;
+
+/* Simulated EEPROM */
+static uint8_t  EEPROM[E2END + 1];
+
+/* Host side of the CDC data endpoints */
+static const uint8_t* OutData;
+static size_t   OutLength;
+static size_t   OutIndex;
+static uint8_t  InData[64];
+static size_t   InLength;
+
+/* USB core stand-ins */
+USB_Request_Header_t USB_ControlRequest;
+
+void USB_Init(void) { }
+void USB_USBTask(void) { }
+void Endpoint_ClearStatusStage(void) { }
+
+bool Endpoint_ConfigureEndpoint_Prv(const uint8_t Number, const uint8_t UECFG0XData, const uint8_t UECFG1XData)
+{
+	return true;
+}
+
+uint8_t Endpoint_Write_Control_Stream_LE(const void* const Buffer, uint16_t Length)
+{
+	return ENDPOINT_RWCSTREAM_NoError;
+}
+
+/** Reads the CDC OUT endpoint from the host data and writes the CDC IN endpoint into the response buffer. */
+volatile uint8_t* HostTest_EndpointData(void)
+{
+	static volatile uint8_t Data;
+
+	if (UENUM == (CDC_RX_EPADDR & ENDPOINT_EPNUM_MASK))
+	{
+		Data = 0;
+		if (OutIndex < OutLength)
+			Data = OutData[OutIndex];
+		OutIndex++;
+	}
+	else if ((UENUM == (CDC_TX_EPADDR & ENDPOINT_EPNUM_MASK)) && (InLength < sizeof(InData)))
+	{
+		return &InData[InLength++];
+	}
+
+	return &Data;
+}
+
+void boot_page_fill(uint32_t Address, uint16_t Data)
+{
+	if (SPMBusy)
+		SPMViolations++;
+
+	PageBuffer[(Address & (SPM_PAGESIZE - 1)) / 2] = Data;
+}
+
+void boot_page_erase(uint32_t Address)
+{
+	if (SPMBusy || (Address >= BOOT_START_ADDR))
+	{
+		SPMViolations++;
+		return;
+	}
+
+	memset(&Flash[Address & ~(SPM_PAGESIZE - 1)], 0xFF, SPM_PAGESIZE);
+	SPMBusy = RWWBusy = true;
+	PageErases++;
+}
+
+void boot_page_write(uint32_t Address)
+{
+	if (SPMBusy || (Address >= BOOT_START_ADDR))
+	{
+		SPMViolations++;
+		return;
+	}
+
+	/* Programming can only clear bits, a page which was not erased before keeps its old ones */
+	uint8_t* Page = &Flash[Address & ~(SPM_PAGESIZE - 1)];
+	for (uint16_t Word = 0; Word < (SPM_PAGESIZE / 2); Word++)
+	{
+		Page[Word * 2]     &= (PageBuffer[Word] & 0xFF);
+		Page[Word * 2 + 1] &= (PageBuffer[Word] >> 8);
+		PageBuffer[Word] = 0xFFFF;
+	}
+
+	SPMBusy = RWWBusy = true;
+	PageWrites++;
+}
+
+void boot_rww_enable(void)
+{
+	if (SPMBusy)
+		SPMViolations++;
+
+	RWWBusy = false;
+	memset(PageBuffer, 0xFF, sizeof(PageBuffer));
+}
+
+/** A running erase or write finishes once it has been polled. */
+bool boot_spm_busy(void)
+{
+	bool Busy = SPMBusy;
+	SPMBusy = false;
+	return Busy;
+}
+
+void boot_spm_busy_wait(void)
+{
+	SPMBusy = false;
+}
+
+bool boot_rww_busy(void)
+{
+	return RWWBusy;
+}
+
+void boot_lock_bits_set(uint8_t LockBits) { }
+
+uint8_t boot_lock_fuse_bits_get(uint8_t Address)
+{
+	return 0xFF;
+}
+
+uint8_t HostTest_FlashReadByte(uint32_t Address)
+{
+	/* The address wraps around like the Z pointer of the LPM instruction */
+	Address &= FLASHEND;
+
+	/* The RWW section reads garbage until it is enabled again after a page erase or write */
+	if ((Address < BOOT_START_ADDR) && RWWBusy)
+	{
+		SPMViolations++;
+		return 0;
+	}
+
+	return Flash[Address];
+}
+
+uint16_t HostTest_FlashReadWord(uint32_t Address)
+{
+	return HostTest_FlashReadByte(Address) | (HostTest_FlashReadByte(Address + 1) << 8);
+}
+
+uint8_t eeprom_read_byte(const uint8_t* Address)
+{
+	return EEPROM[(uintptr_t)Address];
+}
+
+void eeprom_update_byte(uint8_t* Address, uint8_t Value)
+{
+	EEPROM[(uintptr_t)Address] = Value;
+}
+
+/** Clears the flash, the SPM state and the counters. */
+static void ResetFlash(void)
+{
+	memset(Flash, 0xFF, sizeof(Flash));
+	memset(PageBuffer, 0xFF, sizeof(PageBuffer));
+	SPMBusy = RWWBusy = false;
+	SPMViolations = PageErases = PageWrites = 0;
+}
+
+/** Runs the AVR109 commands in the host data like CDC_Task does, followed by a 'P' which finishes a pipelined
+ *  page write. The responses are collected in InData, the one of the 'P' is removed again.
+ */
+static void RunCommands(const uint8_t* Data, size_t Length)
+{
+	OutData = Data;
+	OutLength = Length;
+	OutIndex = 0;
+	InLength = 0;
+
+	UEINTX = (1 << RWAL) | (1 << TXINI) | (1 << RXOUTI);
+	USB_DeviceState = DEVICE_STATE_Configured;
+
+	while (OutIndex < OutLength)
+		Bootloader_Task(FetchNextCommandByte());
+
+	CHECK(OutIndex == OutLength, "%zu bytes of the host data were read, %zu were sent", OutIndex, OutLength);
+
+	Bootloader_Task(AVR109_COMMAND_EnterProgrammingMode);
+	InLength--;
+}
+
+/** Builds an AVR109 command stream which sets the word address and sends a 'W' or 'Z' with the given data. */
+static size_t BuildWriteCommand(uint8_t* Command, uint16_t ByteAddress, uint8_t WriteCommand, const uint8_t* Data,
+                                size_t Length)
+{
+	Command[0] = AVR109_COMMAND_SetCurrentAddress;
+	Command[1] = (ByteAddress >> 1) >> 8;
+	Command[2] = (ByteAddress >> 1) & 0xFF;
+	Command[3] = WriteCommand;
+	Command[4] = Length >> 8;
+	Command[5] = Length & 0xFF;
+	memcpy(&Command[6], Data, Length);
+
+	return Length + 6;
+}
+
+/** Reads a whole file, the length is returned in Length. */
+static uint8_t* ReadFile(const char* Path, size_t* Length)
+{
+	FILE* File = fopen(Path, "rb");
+	if (!File)
+	{
+		printf("Cannot open %s\n", Path);
+		exit(2);
+	}
+
+	uint8_t* Data = malloc(FLASHEND + 1);
+	*Length = fread(Data, 1, FLASHEND + 1, File);
+	fclose(File);
+
+	return Data;
+}
+
+/** Writes a test image with literal data, short and long distance repeats and blank areas. Its odd length makes
+ *  the compressor pad it with 0xFF.
+ */
+static int WriteImage(const char* Path)
+{
+	static uint8_t Image[9001];
+	uint32_t Seed = 1;
+
+	for (size_t i = 0; i < sizeof(Image); i++)
+	{
+		Seed = Seed * 1103515245 + 12345;
+
+		if ((i % 1024) < 300)
+			Image[i] = Seed >> 16;
+		else if ((i % 1024) < 700)
+			Image[i] = Image[i % 300];
+		else if ((i % 1024) < 800)
+			Image[i] = 0xFF;
+		else
+			Image[i] = Image[i - 37] ^ (i & 0x03);
+	}
+
+	FILE* File = fopen(Path, "wb");
+	if (!File || (fwrite(Image, 1, sizeof(Image), File) != sizeof(Image)))
+		return 2;
+	fclose(File);
+
+	return 0;
+}
+
+/** Checks that the flash holds the image from the address on and is blank everywhere else. */
+static void CheckFlash(uint16_t Address, const uint8_t* Image, size_t Length, const char* Name)
+{
+	for (uint32_t i = 0; i <= FLASHEND; i++)
+	{
+		uint8_t Expected = ((i >= Address) && (i < Address + Length)) ? Image[i - Address] : 0xFF;
+		if (Flash[i] != Expected)
+		{
+			CHECK(false, "%s: flash byte 0x%04X is 0x%02X instead of 0x%02X", Name, (unsigned)i, Flash[i], Expected);
+			return;
+		}
+	}
+}
+
+static void TestCompressedWrite(const uint8_t* Image, size_t ImageLength, const uint8_t* Stream, size_t StreamLength)
+{
+	static uint8_t Command[FLASHEND + 16];
+	size_t Length;
+
+	/* Decode into the blank flash */
+	ResetFlash();
+	Length = BuildWriteCommand(Command, 0, AVR109_COMMAND_CompressedWriteFlash, Stream, StreamLength);
+	RunCommands(Command, Length);
+	CHECK((InLength == 2) && (InData[0] == '\r') && (InData[1] == '\r'), "'Z' did not answer '\\r'");
+	CheckFlash(0, Image, ImageLength, "'Z'");
+	CHECK(!SPMViolations, "'Z' broke the SPM rules %u times", SPMViolations);
+	CHECK(PageWrites == (ImageLength + SPM_PAGESIZE - 1) / SPM_PAGESIZE, "'Z' wrote %u pages", PageWrites);
+
+	/* The same image again leaves every page alone */
+	PageWrites = PageErases = 0;
+	RunCommands(Command, Length);
+	CHECK((InLength == 2) && (InData[1] == '\r'), "second 'Z' did not answer '\\r'");
+	CHECK(!PageWrites && !PageErases, "unchanged pages were programmed again");
+	CheckFlash(0, Image, ImageLength, "second 'Z'");
+
+	/* An unaligned start is rejected without touching the flash */
+	ResetFlash();
+	Length = BuildWriteCommand(Command, 2, AVR109_COMMAND_CompressedWriteFlash, Stream, StreamLength);
+	RunCommands(Command, Length);
+	CHECK((InLength == 2) && (InData[1] == '?'), "unaligned 'Z' did not answer '?'");
+	CHECK(!PageWrites && !PageErases, "unaligned 'Z' programmed the flash");
+
+	/* An image reaching into the bootloader only programs the pages below it */
+	ResetFlash();
+	Length = BuildWriteCommand(Command, BOOT_START_ADDR - (2 * SPM_PAGESIZE), AVR109_COMMAND_CompressedWriteFlash,
+	                           Stream, StreamLength);
+	RunCommands(Command, Length);
+	CHECK((InLength == 2) && (InData[1] == '?'), "'Z' into the bootloader did not answer '?'");
+	CHECK(!SPMViolations, "'Z' into the bootloader broke the SPM rules %u times", SPMViolations);
+	CheckFlash(BOOT_START_ADDR - (2 * SPM_PAGESIZE), Image, 2 * SPM_PAGESIZE, "'Z' into the bootloader");
+
+	/* A match without a distance is malformed */
+	static const uint8_t Malformed[] = { 0x01, 0x12, 0x34, 0x80, 0x00, 0x00, 0x00, 0x56 };
+	ResetFlash();
+	Length = BuildWriteCommand(Command, 0, AVR109_COMMAND_CompressedWriteFlash, Malformed, sizeof(Malformed));
+	RunCommands(Command, Length);
+	CHECK((InLength == 2) && (InData[1] == '?'), "malformed 'Z' did not answer '?'");
+}
+
+static void TestStreamWrite(const uint8_t* Image, size_t ImageLength)
+{
+	static uint8_t Command[FLASHEND + 16];
+
+	ResetFlash();
+	size_t Length = BuildWriteCommand(Command, 0, AVR109_COMMAND_StreamWriteFlash, Image, ImageLength);
+	RunCommands(Command, Length);
+	CHECK((InLength == 2) && (InData[1] == '\r'), "'W' did not answer '\\r'");
+	CheckFlash(0, Image, ImageLength, "'W'");
+	CHECK(!SPMViolations, "'W' broke the SPM rules %u times", SPMViolations);
+
+	ResetFlash();
+	Length = BuildWriteCommand(Command, SPM_PAGESIZE + 2, AVR109_COMMAND_StreamWriteFlash, Image, ImageLength);
+	RunCommands(Command, Length);
+	CHECK((InLength == 2) && (InData[1] == '?'), "unaligned 'W' did not answer '?'");
+	CHECK(!PageWrites && !PageErases, "unaligned 'W' programmed the flash");
+}
+
+/** COBS encodes the payload with its big endian CRC-16 (XMODEM) and the delimiter, the length is returned. */
+static size_t EncodeFrame(uint8_t* Frame, const uint8_t* Payload, size_t Length, bool CorruptCRC)
+{
+	uint8_t Data[1024];
+	uint16_t CRC = 0;
+
+	memcpy(Data, Payload, Length);
+	for (size_t i = 0; i < Length; i++)
+		CRC = _crc_xmodem_update(CRC, Payload[i]);
+	if (CorruptCRC)
+		CRC ^= 0x0100;
+	Data[Length++] = CRC >> 8;
+	Data[Length++] = CRC & 0xFF;
+
+	size_t FrameLength = 1;
+	size_t CodeIndex = 0;
+	uint8_t Code = 1;
+
+	for (size_t i = 0; i < Length; i++)
+	{
+		if (Data[i])
+		{
+			Frame[FrameLength++] = Data[i];
+			Code++;
+		}
+
+		if (!Data[i] || (Code == 0xFF))
+		{
+			Frame[CodeIndex] = Code;
+			CodeIndex = FrameLength++;
+			Code = 1;
+		}
+	}
+
+	Frame[CodeIndex] = Code;
+	Frame[FrameLength++] = 0x00;
+
+	return FrameLength;
+}
+
+/** Sends the bytes to the USART receive ISR. */
+static void ReceiveBytes(const uint8_t* Data, size_t Length)
+{
+	for (size_t i = 0; i < Length; i++)
+	{
+		UDR1 = Data[i];
+		USART1_RX_vect();
+	}
+}
+
+/** Checks that the USART->USB buffer holds exactly the given complete frames. */
+static void CheckFramedBuffer(const uint8_t* Frames, size_t Length, const char* Name)
+{
+	CHECK((FramedBytes == Length) && (BufferCount == Length), "%s: %u framed and %u buffered bytes instead of %zu",
+	      Name, (unsigned)FramedBytes, (unsigned)BufferCount, Length);
+
+	for (size_t i = 0; (i < Length) && (i < BufferCount); i++)
+	{
+		if (USARTtoUSB_Buffer_Data[(BufferIndex + i) % BUFFER_SIZE] != Frames[i])
+		{
+			CHECK(false, "%s: buffer byte %zu differs", Name, i);
+			return;
+		}
+	}
+}
+
+static void TestFraming(void)
+{
+	static const uint8_t Text[] = "HoodLoader2";
+	static const uint8_t Zeros[] = { 0x00, 0x01, 0x00, 0x00, 0x02, 0x00 };
+	uint8_t Long[300];
+	uint8_t Frames[1024];
+	uint8_t Corrupt[64];
+
+	for (size_t i = 0; i < sizeof(Long); i++)
+		Long[i] = (i % 251) + 1;
+
+	/* The CRC of the stand-in has to be the XMODEM one */
+	uint16_t CRC = 0;
+	for (const char* Check = "123456789"; *Check; Check++)
+		CRC = _crc_xmodem_update(CRC, *Check);
+	CHECK(CRC == 0x31C3, "CRC-16 (XMODEM) check value is 0x%04X", CRC);
+
+	USB_DeviceState = DEVICE_STATE_Configured;
+	LineEncoding.BaudRateBPS = 115200;
+	LineEncoding.DataBits = 8;
+	CDC_Device_LineEncodingChanged();
+	FramingMode = FRAMING_MODE_COBS_CRC16;
+
+	/* Valid frames, including zeros in the payload and a block of more than 254 bytes, are kept complete */
+	size_t Length = EncodeFrame(Frames, Text, sizeof(Text) - 1, false);
+	Length += EncodeFrame(&Frames[Length], Zeros, sizeof(Zeros), false);
+	ReceiveBytes(Frames, Length);
+	CheckFramedBuffer(Frames, Length, "short frames");
+
+	CDC_Device_LineEncodingChanged();
+	Length = EncodeFrame(Frames, Long, sizeof(Long), false);
+	ReceiveBytes(Frames, Length);
+	CheckFramedBuffer(Frames, Length, "long frame");
+
+	/* An incomplete frame is held back until its delimiter arrives */
+	CDC_Device_LineEncodingChanged();
+	Length = EncodeFrame(Frames, Text, sizeof(Text) - 1, false);
+	ReceiveBytes(Frames, Length - 1);
+	CHECK(!FramedBytes && (BufferCount == Length - 1), "an incomplete frame was released");
+	ReceiveBytes(&Frames[Length - 1], 1);
+	CheckFramedBuffer(Frames, Length, "completed frame");
+
+	/* A wrong CRC or a corrupted byte drops the frame, the following one is kept */
+	CDC_Device_LineEncodingChanged();
+	size_t CorruptLength = EncodeFrame(Corrupt, Text, sizeof(Text) - 1, true);
+	ReceiveBytes(Corrupt, CorruptLength);
+	CorruptLength = EncodeFrame(Corrupt, Zeros, sizeof(Zeros), false);
+	Corrupt[3] ^= 0x40;
+	ReceiveBytes(Corrupt, CorruptLength);
+	ReceiveBytes(Frames, Length);
+	CHECK(DroppedFrames == 2, "%u frames were dropped instead of 2", DroppedFrames);
+	CheckFramedBuffer(Frames, Length, "frame after corrupt ones");
+
+	/* Without the CRC check any frame is passed on, empty ones are dropped silently */
+	CDC_Device_LineEncodingChanged();
+	FramingMode = FRAMING_MODE_COBS;
+	static const uint8_t Raw[] = { 0x00, 0x03, 0x11, 0x22, 0x00 };
+	ReceiveBytes(Raw, sizeof(Raw));
+	CheckFramedBuffer(&Raw[1], sizeof(Raw) - 1, "frame without CRC");
+	CHECK(!DroppedFrames, "an empty frame was counted as dropped");
+
+	FramingMode = FRAMING_MODE_NONE;
+}
+
+static void TestBaudRate(void)
+{
+	/* Baud rate, UBRR1 and double speed mode of the well known rates at 16MHz */
+	static const struct
+	{
+		uint32_t BaudRateBPS;
+		uint16_t UBRR;
+		bool     DoubleSpeed;
+	} Rates[] = {
+		{     50, 4095, false },
+		{    300, 3332, false },
+		{   9600,  103, false },
+		{  57600,   34, true  },
+		{ 115200,   16, true  },
+		{ 250000,    3, false },
+		{ 500000,    1, false },
+		{1000000,    0, false },
+		{2000000,    0, true  },
+	};
+
+	LineEncoding.DataBits = 8;
+
+	for (uint8_t i = 0; i < (sizeof(Rates) / sizeof(Rates[0])); i++)
+	{
+		LineEncoding.BaudRateBPS = Rates[i].BaudRateBPS;
+		CDC_Device_LineEncodingChanged();
+
+		CHECK((UBRR1 == Rates[i].UBRR) && (!!(UCSR1A & (1 << U2X1)) == Rates[i].DoubleSpeed),
+		      "%lu baud: UBRR1 %u U2X1 %u", (unsigned long)Rates[i].BaudRateBPS, UBRR1, !!(UCSR1A & (1 << U2X1)));
+	}
+
+	/* Every other rate gets the closest divider the USART can reach, and the reported rate matches the registers */
+	for (uint32_t BaudRateBPS = 300; BaudRateBPS <= 2000000; BaudRateBPS += (BaudRateBPS / 64) + 1)
+	{
+		LineEncoding.BaudRateBPS = BaudRateBPS;
+		CDC_Device_LineEncodingChanged();
+
+		bool DoubleSpeed = (UCSR1A & (1 << U2X1));
+		uint32_t Divider = (UBRR1 + 1) * (DoubleSpeed ? 1 : 2);
+		double Ideal = (F_CPU / 8.0) / BaudRateBPS;
+
+		double BestError = 1e9;
+		for (uint32_t Candidate = 1; Candidate <= 8192; Candidate++)
+		{
+			if (((Candidate <= 4096) || !(Candidate & 1)) && (fabs(Candidate - Ideal) < BestError))
+				BestError = fabs(Candidate - Ideal);
+		}
+
+		CHECK(fabs(Divider - Ideal) <= BestError + ((Divider > 4096) ? 1 : 0.5),
+		      "%lu baud: divider %lu, ideal %.2f", (unsigned long)BaudRateBPS, (unsigned long)Divider, Ideal);
+		CHECK(!DoubleSpeed || (Divider & 1), "%lu baud: double speed mode for an even divider",
+		      (unsigned long)BaudRateBPS);
+		CHECK(BaudDivider == Divider, "%lu baud: GetBaudRate divider %u instead of %lu",
+		      (unsigned long)BaudRateBPS, BaudDivider, (unsigned long)Divider);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if ((argc == 3) && !strcmp(argv[1], "--image"))
+		return WriteImage(argv[2]);
+
+	if (argc != 3)
+	{
+		printf("Usage: %s --image <file> | %s <image> <compressed image>\n", argv[0], argv[0]);
+		return 2;
+	}
+
+	size_t ImageLength;
+	size_t StreamLength;
+	uint8_t* Image = ReadFile(argv[1], &ImageLength);
+	uint8_t* Stream = ReadFile(argv[2], &StreamLength);
+
+	/* The compressor pads the image to whole words */
+	if (ImageLength & 1)
+		Image[ImageLength++] = 0xFF;
+
+	TestCompressedWrite(Image, ImageLength, Stream, StreamLength);
+	TestStreamWrite(Image, ImageLength);
+	TestFraming();
+	TestBaudRate();
+
+	free(Image);
+	free(Stream);
+
+	printf("%s (%u failed checks)\n", Failures ? "FAILED" : "PASSED", Failures);
+	return Failures ? 1 : 0;
+}
@@ -0,0 +1,54 @@
+/*
+Copyright(c) 2014-2015 NicoHood
+See the readme for credit to other people.
+
+This file is part of Hoodloader2.
+
+Hoodloader2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Hoodloader2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+ *
+ *  Host stand-in for the self programming functions, implemented on the simulated flash in HostTest.c.
+ */
+
+#ifndef _HOSTTEST_AVR_BOOT_H_
+#define _HOSTTEST_AVR_BOOT_H_
+
+	#include <stdint.h>
+	#include <stdbool.h>
+
+	#define GET_LOW_FUSE_BITS      0
+	#define GET_LOCK_BITS          1
+	#define GET_EXTENDED_FUSE_BITS 2
+	#define GET_HIGH_FUSE_BITS     3
+
+	void    boot_page_fill(uint32_t Address, uint16_t Data);
+	void    boot_page_erase(uint32_t Address);
+	void    boot_page_write(uint32_t Address);
+	void    boot_rww_enable(void);
+	bool    boot_spm_busy(void);
+	void    boot_spm_busy_wait(void);
+	bool    boot_rww_busy(void);
+	void    boot_lock_bits_set(uint8_t LockBits);
+	uint8_t boot_lock_fuse_bits_get(uint8_t Address);
+	uint8_t boot_signature_byte_get(uint8_t Address);
+
+	#define boot_page_fill_safe(Address, Data)  boot_page_fill(Address, Data)
+	#define boot_page_erase_safe(Address)       boot_page_erase(Address)
+	#define boot_page_write_safe(Address)       boot_page_write(Address)
+	#define boot_rww_enable_safe()              boot_rww_enable()
+	#define boot_lock_bits_set_safe(LockBits)   boot_lock_bits_set(LockBits)
+
+#endif
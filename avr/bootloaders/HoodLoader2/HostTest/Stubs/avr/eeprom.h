@@ -0,0 +1,44 @@
+/*
+Copyright(c) 2014-2015 NicoHood
+See the readme for credit to other people.
+
+This file is part of Hoodloader2.
+
+Hoodloader2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Hoodloader2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+ *
+ *  Host stand-in for the EEPROM access, implemented in HostTest.c.
+ */
+
+#ifndef _HOSTTEST_AVR_EEPROM_H_
+#define _HOSTTEST_AVR_EEPROM_H_
+
+	#include <stdint.h>
+	#include <stddef.h>
+
+	#define EEMEM
+	#define eeprom_is_ready()   1
+	#define eeprom_busy_wait()
+
+	uint8_t  eeprom_read_byte(const uint8_t* Address);
+	void     eeprom_write_byte(uint8_t* Address, uint8_t Value);
+	void     eeprom_update_byte(uint8_t* Address, uint8_t Value);
+	uint16_t eeprom_read_word(const uint16_t* Address);
+	void     eeprom_update_word(uint16_t* Address, uint16_t Value);
+	void     eeprom_read_block(void* Destination, const void* Source, size_t Length);
+	void     eeprom_update_block(const void* Source, void* Destination, size_t Length);
+
+#endif
@@ -0,0 +1,35 @@
+/*
+Copyright(c) 2014-2015 NicoHood
+See the readme for credit to other people.
+
+This file is part of Hoodloader2.
+
+Hoodloader2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Hoodloader2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+ *
+ *  Host stand-in for the interrupt macros, an ISR is a plain function the test calls directly.
+ */
+
+#ifndef _HOSTTEST_AVR_INTERRUPT_H_
+#define _HOSTTEST_AVR_INTERRUPT_H_
+
+	#define ISR_BLOCK
+	#define ISR_NOBLOCK
+	#define ISR(Vector, ...)  void Vector(void); void Vector(void)
+	#define sei()
+	#define cli()
+
+#endif
@@ -0,0 +1,181 @@
+/*
+Copyright(c) 2014-2015 NicoHood
+See the readme for credit to other people.
+
+This file is part of Hoodloader2.
+
+Hoodloader2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Hoodloader2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+ *
+ *  Host stand-in for the ATmega16u2 register file. The registers are plain variables defined in HostTest.c, the
+ *  bit numbers match the datasheet. The endpoint FIFO is routed through HostTest_EndpointData(), which streams the
+ *  host data of the CDC OUT endpoint and records the bytes written to the IN endpoints.
+ */
+
+#ifndef _HOSTTEST_AVR_IO_H_
+#define _HOSTTEST_AVR_IO_H_
+
+	#include <stdint.h>
+
+	#define HOSTTEST_REGISTERS(REG8, REG16) \
+		REG8(SREG) REG8(MCUCR) REG8(MCUSR) REG8(GPIOR0) REG8(PLLCSR) REG8(REGCR) \
+		REG8(PINB) REG8(DDRB) REG8(PORTB) REG8(PIND) REG8(DDRD) REG8(PORTD) \
+		REG8(EICRA) REG8(EIMSK) REG8(EIFR) REG8(SPCR) REG8(SPDR) \
+		REG8(TCCR0B) REG8(TCNT0) REG8(TIFR0) REG8(TCCR1B) REG16(TCNT1) REG8(TIFR1) REG8(TIMSK1) \
+		REG8(UCSR1A) REG8(UCSR1B) REG8(UCSR1C) REG16(UBRR1) REG8(UDR1) \
+		REG8(USBCON) REG8(UDCON) REG8(UDINT) REG8(UDIEN) REG8(UDADDR) REG16(UDFNUM) \
+		REG8(UENUM) REG8(UERST) REG8(UECONX) REG8(UECFG0X) REG8(UECFG1X) REG8(UESTA0X) REG8(UEINTX) REG8(UEIENX) \
+		REG8(UEBCLX) REG8(UEINT)
+
+	#define HOSTTEST_DECLARE_REG8(Name)  extern volatile uint8_t Name;
+	#define HOSTTEST_DECLARE_REG16(Name) extern volatile uint16_t Name;
+	HOSTTEST_REGISTERS(HOSTTEST_DECLARE_REG8, HOSTTEST_DECLARE_REG16)
+
+	volatile uint8_t* HostTest_EndpointData(void);
+	#define UEDATX            (*HostTest_EndpointData())
+
+	#define _BV(Bit)          (1 << (Bit))
+	#define _SFR_MEM8(Addr)   (*(volatile uint8_t*)(Addr))
+
+	#define SPM_PAGESIZE      128
+	#define FLASHEND          0x3FFF
+	#define RAMEND            0x2FF
+	#define E2END             0x1FF
+
+	/* Port bits */
+	#define PB0 0
+	#define PB1 1
+	#define PB2 2
+	#define PB3 3
+	#define PB4 4
+	#define PB5 5
+	#define PB6 6
+	#define PB7 7
+	#define PD0 0
+	#define PD1 1
+	#define PD2 2
+	#define PD3 3
+	#define PD4 4
+	#define PD5 5
+	#define PD6 6
+	#define PD7 7
+
+	/* MCU control */
+	#define IVCE 0
+	#define IVSEL 1
+	#define PORF 0
+	#define EXTRF 1
+	#define BORF 2
+	#define WDRF 3
+	#define USBRF 5
+	#define PLOCK 0
+	#define PLLE 1
+	#define PLLP0 2
+	#define PLLP1 3
+	#define PLLP2 4
+	#define REGDIS 0
+
+	/* External interrupt, SPI and timers */
+	#define INT2 2
+	#define INTF2 2
+	#define ISC20 4
+	#define ISC21 5
+	#define SPE 6
+	#define SPIE 7
+	#define CS00 0
+	#define CS01 1
+	#define CS02 2
+	#define TOV0 0
+	#define CS10 0
+	#define CS11 1
+	#define CS12 2
+	#define TOV1 0
+	#define TOIE1 0
+
+	/* USART1 */
+	#define MPCM1 0
+	#define U2X1 1
+	#define UPE1 2
+	#define DOR1 3
+	#define FE1 4
+	#define UDRE1 5
+	#define TXC1 6
+	#define RXC1 7
+	#define UCSZ12 2
+	#define TXEN1 3
+	#define RXEN1 4
+	#define UDRIE1 5
+	#define TXCIE1 6
+	#define RXCIE1 7
+	#define UCPOL1 0
+	#define UCSZ10 1
+	#define UCSZ11 2
+	#define USBS1 3
+	#define UPM10 4
+	#define UPM11 5
+
+	/* USB controller */
+	#define FRZCLK 5
+	#define USBE 7
+	#define DETACH 0
+	#define RMWKUP 1
+	#define RSTCPU 2
+	#define SUSPI 0
+	#define SOFI 2
+	#define EORSTI 3
+	#define WAKEUPI 4
+	#define EORSMI 5
+	#define UPRSMI 6
+	#define SUSPE 0
+	#define SOFE 2
+	#define EORSTE 3
+	#define WAKEUPE 4
+	#define EORSME 5
+	#define UPRSME 6
+	#define ADDEN 7
+	#define EPEN 0
+	#define RSTDT 3
+	#define STALLRQC 4
+	#define STALLRQ 5
+	#define EPDIR 0
+	#define EPTYPE0 6
+	#define EPTYPE1 7
+	#define ALLOC 1
+	#define EPBK0 2
+	#define EPBK1 3
+	#define EPSIZE0 4
+	#define EPSIZE1 5
+	#define EPSIZE2 6
+	#define NBUSYBK0 0
+	#define NBUSYBK1 1
+	#define CFGOK 7
+	#define TXINI 0
+	#define STALLEDI 1
+	#define RXOUTI 2
+	#define RXSTPI 3
+	#define NAKOUTI 4
+	#define RWAL 5
+	#define NAKINI 6
+	#define FIFOCON 7
+	#define TXINE 0
+	#define STALLEDE 1
+	#define RXOUTE 2
+	#define RXSTPE 3
+	#define NAKOUTE 4
+	#define NAKINE 6
+	#define FLERRE 7
+
+#endif
@@ -0,0 +1,44 @@
+/*
+Copyright(c) 2014-2015 NicoHood
+See the readme for credit to other people.
+
+This file is part of Hoodloader2.
+
+Hoodloader2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Hoodloader2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+ *
+ *  Host stand-in for the flash access. Numeric addresses read the simulated flash of HostTest.c.
+ */
+
+#ifndef _HOSTTEST_AVR_PGMSPACE_H_
+#define _HOSTTEST_AVR_PGMSPACE_H_
+
+	#include <stdint.h>
+	#include <string.h>
+
+	#define PROGMEM
+	#define PSTR(s)                  (s)
+	#define memcpy_P                 memcpy
+
+	uint8_t  HostTest_FlashReadByte(uint32_t Address);
+	uint16_t HostTest_FlashReadWord(uint32_t Address);
+
+	#define pgm_read_byte(Address)     HostTest_FlashReadByte((uintptr_t)(Address))
+	#define pgm_read_word(Address)     HostTest_FlashReadWord((uintptr_t)(Address))
+	#define pgm_read_byte_far(Address) HostTest_FlashReadByte(Address)
+	#define pgm_read_word_far(Address) HostTest_FlashReadWord(Address)
+
+#endif
@@ -0,0 +1,59 @@
+/*
+Copyright(c) 2014-2015 NicoHood
+See the readme for credit to other people.
+
+This file is part of Hoodloader2.
+
+Hoodloader2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Hoodloader2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/** \file
+ *
+ *  Host version of the avr-libc CRC functions, the same algorithms as the reference C code of avr-libc.
+ */
+
+#ifndef _HOSTTEST_UTIL_CRC16_H_
+#define _HOSTTEST_UTIL_CRC16_H_
+
+	#include <stdint.h>
+
+	static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+	{
+		crc = crc ^ ((uint16_t)data << 8);
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			if (crc & 0x8000)
+				crc = (crc << 1) ^ 0x1021;
+			else
+				crc <<= 1;
+		}
+
+		return crc;
+	}
+
+	static inline uint16_t _crc16_update(uint16_t crc, uint8_t data)
+	{
+		crc ^= data;
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			if (crc & 1)
+				crc = (crc >> 1) ^ 0xA001;
+			else
+				crc = (crc >> 1);
+		}
+
+		return crc;
+	}
+
+#endif
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""
+Copyright(c) 2014-2015 NicoHood
+See the readme for credit to other people.
+
+This file is part of Hoodloader2.
+
+Hoodloader2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Hoodloader2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Hoodloader2.  If not, see <http://www.gnu.org/licenses/>.
+
+Compressor for the HoodLoader2 compressed flash write command 'Z'
+(bootloader built with COMPRESSED_WRITE_SUPPORT).
+
+The stream is a sequence of tokens:
+ * 0x00-0x7F: literal run, followed by (token + 1) raw bytes
+ * 0x80-0xFF: match of ((token & 0x7F) + 3) bytes, followed by a 16 bit big
+   endian distance back into the already written image
+
+Matches may reach back to the start of the image, since the bootloader reads
+older data back from the flash. The image always starts at flash address 0
+(hex files are placed at their absolute addresses, gaps are filled with
+0xFF) and is padded to an even length, since the bootloader only programs
+whole words. The compressed stream must not exceed 65535 bytes.
+
+Usage:
+    hoodloader2_compress.py sketch.hex sketch.hlz
+
+The output is verified by decompressing it again before it is written.
+The host then sends 'A' 0x00 0x00 (address 0) followed by
+'Z' <size MSB> <size LSB> and the stream, and waits for a single '\\r'.
+The bootloader answers '?' instead if the stream is malformed.
+"""
+
+import sys
+
+MIN_MATCH = 4  # 3 byte matches are allowed, but do not save anything
+MAX_MATCH = 0x7F + 3
+MAX_LITERALS = 0x80
+MAX_DISTANCE = 0xFFFF
+MAX_CHAIN = 256
+
+
+def read_image(path):
+    """Reads an Intel hex file (or a raw binary) into a bytearray, gaps are filled with 0xFF."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if not path.lower().endswith('.hex'):
+        return bytearray(data)
+
+    image = bytearray()
+    base = 0
+    for line in data.decode('ascii').splitlines():
+        line = line.strip()
+        if not line.startswith(':'):
+            continue
+        record = bytes.fromhex(line[1:])
+        if sum(record) & 0xFF:
+            raise ValueError('Checksum error in line: ' + line)
+        length, address, rtype = record[0], (record[1] << 8) | record[2], record[3]
+        payload = record[4:4 + length]
+        if rtype == 0x00:
+            start = base + address
+            if len(image) < start + length:
+                image.extend(b'\xFF' * (start + length - len(image)))
+            image[start:start + length] = payload
+        elif rtype == 0x01:
+            break
+        elif rtype == 0x02:
+            base = ((payload[0] << 8) | payload[1]) << 4
+        elif rtype == 0x04:
+            base = ((payload[0] << 8) | payload[1]) << 16
+    return image
+
+
+def compress(image):
+    """Greedy LZ77 compression with hash chains over the whole preceding image."""
+    out = bytearray()
+    chains = {}
+    literals = bytearray()
+    pos = 0
+
+    def flush_literals():
+        while literals:
+            run = literals[:MAX_LITERALS]
+            del literals[:MAX_LITERALS]
+            out.append(len(run) - 1)
+            out.extend(run)
+
+    def insert(at):
+        if at + 3 <= len(image):
+            chains.setdefault(bytes(image[at:at + 3]), []).append(at)
+
+    while pos < len(image):
+        best_length, best_distance = 0, 0
+        candidates = chains.get(bytes(image[pos:pos + 3]), [])
+        for candidate in reversed(candidates[-MAX_CHAIN:]):
+            distance = pos - candidate
+            if distance > MAX_DISTANCE:
+                break
+            length = 0
+            limit = min(MAX_MATCH, len(image) - pos)
+            while length < limit and image[candidate + length] == image[pos + length]:
+                length += 1
+            if length > best_length:
+                best_length, best_distance = length, distance
+                if length == limit:
+                    break
+
+        if best_length >= MIN_MATCH:
+            flush_literals()
+            out.append(0x80 | (best_length - 3))
+            out.append(best_distance >> 8)
+            out.append(best_distance & 0xFF)
+            for i in range(best_length):
+                insert(pos + i)
+            pos += best_length
+        else:
+            literals.append(image[pos])
+            insert(pos)
+            pos += 1
+
+    flush_literals()
+    return out
+
+
+def decompress(stream):
+    """Reference decoder, works the same way as the bootloader."""
+    image = bytearray()
+    pos = 0
+    while pos < len(stream):
+        token = stream[pos]
+        pos += 1
+        if token & 0x80:
+            length = (token & 0x7F) + 3
+            distance = (stream[pos] << 8) | stream[pos + 1]
+            pos += 2
+            for _ in range(length):
+                image.append(image[len(image) - distance])
+        else:
+            length = token + 1
+            image.extend(stream[pos:pos + length])
+            pos += length
+    return image
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__)
+        return 1
+
+    image = read_image(sys.argv[1])
+
+    # the bootloader only programs whole words, a trailing odd byte would be lost
+    if len(image) & 1:
+        image.append(0xFF)
+
+    stream = compress(image)
+
+    if decompress(stream) != image:
+        print('Error: round trip verification failed')
+        return 1
+    if len(stream) > 0xFFFF:
+        print('Error: compressed image is too big for a single transfer')
+        return 1
+
+    with open(sys.argv[2], 'wb') as f:
+        f.write(stream)
+
+    print('%d -> %d bytes (%.1f%%), start address 0x0000' % (len(image), len(stream), 100.0 * len(stream) / max(len(image), 1)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())